@@ -31,6 +31,15 @@ typedef enum {
 	DRIVE_EMU  = 4
 } DDRIVE;
 
+/* SD card transfers since the last disk_reset_stats() */
+typedef struct {
+	DWORD rd_cmds;
+	DWORD rd_sectors;
+	DWORD wr_cmds;
+	DWORD wr_sectors;
+	DWORD erase_cmds;
+} DSTATS;
+
 
 /*---------------------------------------*/
 /* Prototypes for disk control functions */
@@ -42,6 +51,12 @@ DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 DRESULT disk_set_info (BYTE pdrv, BYTE cmd, void *buff);
+void disk_get_stats (DSTATS *st);
+void disk_reset_stats (void);
+#ifdef DISK_TRACE
+bool disk_trace_start (void);
+int disk_trace_save (const char *path);
+#endif
 
 
 /* Disk Status Bits (DSTATUS) */
@@ -77,6 +92,8 @@ DRESULT disk_set_info (BYTE pdrv, BYTE cmd, void *buff);
 #define ISDIO_READ			55	/* Read data form SD iSDIO register */
 #define ISDIO_WRITE			56	/* Write data to SD iSDIO register */
 #define ISDIO_MRITE			57	/* Masked write data to SD iSDIO register */
+#define CTRL_TRIM_FLUSH		60	/* Erase all queued CTRL_TRIM ranges */
+#define CTRL_SET_SHAPING	61	/* Set write shaping chunk and minimum run size in sectors (DWORD[2]) */
 
 /* ATA/CF specific ioctl command */
 #define ATA_GET_REV			20	/* Get F/W revision */
@@ -524,14 +524,58 @@ static WCHAR LfnBuf[FF_MAX_LFN + 1];		/* LFN working buffer */
 
 #elif FF_USE_LFN == 3 	/* LFN enabled with dynamic working buffer on the heap */
 #if FF_FS_EXFAT
+#define NAMBUF_SZ		((FF_MAX_LFN+1)*2 + MAXDIRB(FF_MAX_LFN))
 #define DEF_NAMBUF		WCHAR *lfn;	/* Pointer to LFN working buffer and directory entry block scratchpad buffer */
-#define INIT_NAMBUF(fs)	{ lfn = ff_memalloc((FF_MAX_LFN+1)*2 + MAXDIRB(FF_MAX_LFN)); if (!lfn) LEAVE_FF(fs, FR_NOT_ENOUGH_CORE); (fs)->lfnbuf = lfn; (fs)->dirbuf = (BYTE*)(lfn+FF_MAX_LFN+1); }
-#define FREE_NAMBUF()	ff_memfree(lfn)
+#define INIT_NAMBUF(fs)	{ lfn = nambuf_get(); if (!lfn) LEAVE_FF(fs, FR_NOT_ENOUGH_CORE); (fs)->lfnbuf = lfn; (fs)->dirbuf = (BYTE*)(lfn+FF_MAX_LFN+1); }
+#define FREE_NAMBUF()	nambuf_put(lfn)
 #else
+#define NAMBUF_SZ		((FF_MAX_LFN+1)*2)
 #define DEF_NAMBUF		WCHAR *lfn;	/* Pointer to LFN working buffer */
-#define INIT_NAMBUF(fs)	{ lfn = ff_memalloc((FF_MAX_LFN+1)*2); if (!lfn) LEAVE_FF(fs, FR_NOT_ENOUGH_CORE); (fs)->lfnbuf = lfn; }
-#define FREE_NAMBUF()	ff_memfree(lfn)
+#define INIT_NAMBUF(fs)	{ lfn = nambuf_get(); if (!lfn) LEAVE_FF(fs, FR_NOT_ENOUGH_CORE); (fs)->lfnbuf = lfn; }
+#define FREE_NAMBUF()	nambuf_put(lfn)
 #endif
+#if FF_NAMBUF_DEPTH > 8
+#error Wrong setting of FF_NAMBUF_DEPTH
+#endif
+#if FF_NAMBUF_DEPTH && FF_FS_REENTRANT
+#error FF_NAMBUF_DEPTH needs FF_FS_REENTRANT == 0, the pool is shared by all volumes
+#endif
+#if FF_NAMBUF_DEPTH
+static WCHAR NamBuf[FF_NAMBUF_DEPTH][NAMBUF_SZ / 2];	/* Preallocated working buffers */
+static BYTE NamBufUse;								/* Bit map of the buffers in use */
+#endif
+
+static WCHAR* nambuf_get (void)	/* Returns a working buffer (null if not enough core) */
+{
+#if FF_NAMBUF_DEPTH
+	UINT i;
+
+	for (i = 0; i < FF_NAMBUF_DEPTH; i++) {
+		if (!(NamBufUse & 1 << i)) {
+			NamBufUse |= 1 << i;
+			return NamBuf[i];
+		}
+	}
+#endif
+	return ff_memalloc(NAMBUF_SZ);	/* All preallocated buffers are taken */
+}
+
+static void nambuf_put (
+	WCHAR* lfn		/* Buffer returned by nambuf_get() */
+)
+{
+#if FF_NAMBUF_DEPTH
+	UINT i;
+
+	for (i = 0; i < FF_NAMBUF_DEPTH; i++) {
+		if (lfn == NamBuf[i]) {
+			NamBufUse &= ~(1 << i);
+			return;
+		}
+	}
+#endif
+	ff_memfree(lfn);
+}
 #define LEAVE_MKFS(res)	{ if (!work) ff_memfree(buf); return res; }
 #define MAX_MALLOC	0x8000	/* Must be >=FF_MAX_SS */
 
@@ -1117,6 +1161,267 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 
+#if FF_FAT_CACHE && !FF_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* Resident FAT (FAT32) or allocation bitmap (exFAT)                     */
+/*-----------------------------------------------------------------------*/
+
+static struct {
+	FATFS* fs;			/* Volume owning the cache (0:Inactive) */
+	DWORD* tbl;			/* FAT32: FAT entries, exFAT: allocation bitmap (as on the disk) */
+	DWORD* freemap;		/* FAT32: Free cluster bitmap (1:Free) */
+	DWORD* dirty;		/* Dirty sector bitmap */
+	DWORD base;			/* First sector of the cached table */
+	DWORD nsect;		/* Number of cached sectors */
+	DWORD dlo, dhi;		/* Dirty sector range [dlo, dhi) */
+} FatCache;
+
+
+static void fatc_load (
+	FATFS* fs		/* Filesystem object (FAT32 or exFAT) */
+)
+{
+	DWORD nsect, tbl_sz, map_sz, dirty_sz;
+	DWORD sect, n, clst, nfree;
+	BYTE *p = (BYTE*)FF_FAT_CACHE_ADDR;
+
+
+	FatCache.fs = 0;
+#if FF_FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {
+		nsect = ((fs->n_fatent - 2 + 7) / 8 + SS(fs) - 1) / SS(fs);
+		FatCache.base = fs->bitbase;
+		map_sz = 0;
+	} else
+#endif
+	{
+		nsect = fs->fsize;
+		FatCache.base = fs->fatbase;
+		map_sz = (fs->n_fatent + 31) / 32 * 4;
+	}
+	if (nsect > FF_FAT_CACHE_SZ / SS(fs)) return;	/* Does not fit */
+	tbl_sz = nsect * SS(fs);
+	dirty_sz = (nsect + 31) / 32 * 4;
+	if (tbl_sz + map_sz + dirty_sz > FF_FAT_CACHE_SZ) return;
+
+	for (sect = 0; sect < nsect; sect += n) {	/* Read the table with large transfers */
+		n = nsect - sect;
+		if (n > 0x4000) n = 0x4000;
+		if (disk_read(fs->pdrv, p + sect * SS(fs), FatCache.base + sect, n) != RES_OK) return;
+	}
+
+	FatCache.tbl = (DWORD*)p;
+	FatCache.freemap = (DWORD*)(p + tbl_sz);
+	FatCache.dirty = (DWORD*)(p + tbl_sz + map_sz);
+	mem_set(FatCache.freemap, 0, map_sz);
+	mem_set(FatCache.dirty, 0, dirty_sz);
+	FatCache.nsect = nsect;
+	FatCache.dlo = nsect; FatCache.dhi = 0;
+
+	nfree = 0;
+#if FF_FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {
+		for (clst = 0; clst < fs->n_fatent - 2; clst++) {	/* Count zero bits */
+			if (!(clst % 32) && clst + 32 <= fs->n_fatent - 2) {
+				if (FatCache.tbl[clst / 32] == 0) { nfree += 32; clst += 31; continue; }
+				if (FatCache.tbl[clst / 32] == 0xFFFFFFFF) { clst += 31; continue; }
+			}
+			if (!(FatCache.tbl[clst / 32] & (1U << (clst % 32)))) nfree++;
+		}
+	} else
+#endif
+	{
+		for (clst = 2; clst < fs->n_fatent; clst++) {
+			if ((FatCache.tbl[clst] & 0x0FFFFFFF) == 0) {
+				FatCache.freemap[clst / 32] |= 1U << (clst % 32);
+				nfree++;
+			}
+		}
+	}
+	fs->free_clst = nfree;		/* Free cluster count is valid from now on */
+	FatCache.fs = fs;
+}
+
+
+static void fatc_set_dirty (
+	DWORD ssect,	/* First dirty sector (relative to the table) */
+	DWORD esect		/* Last dirty sector */
+)
+{
+	DWORD sect;
+
+
+	for (sect = ssect; sect <= esect; sect++) {
+		FatCache.dirty[sect / 32] |= 1U << (sect % 32);
+	}
+	if (ssect < FatCache.dlo) FatCache.dlo = ssect;
+	if (esect >= FatCache.dhi) FatCache.dhi = esect + 1;
+}
+
+
+static void fatc_put (
+	FATFS* fs,		/* Filesystem object */
+	DWORD clst,		/* FAT index number */
+	DWORD val		/* New value */
+)
+{
+	DWORD sect = clst / (SS(fs) / 4);
+
+
+	val = (val & 0x0FFFFFFF) | (FatCache.tbl[clst] & 0xF0000000);
+	FatCache.tbl[clst] = val;
+	if (val & 0x0FFFFFFF) {
+		FatCache.freemap[clst / 32] &= ~(1U << (clst % 32));
+	} else {
+		FatCache.freemap[clst / 32] |= 1U << (clst % 32);
+	}
+	fatc_set_dirty(sect, sect);
+}
+
+
+static DWORD fatc_find_free (	/* 0:No free cluster, >=2:Free cluster# */
+	FATFS* fs,		/* Filesystem object */
+	DWORD scl		/* Cluster# to start after (next-fit) */
+)
+{
+	DWORD clst, i, n, w;
+	DWORD nw = (fs->n_fatent + 31) / 32;
+
+
+	clst = scl + 1;
+	if (clst < 2 || clst >= fs->n_fatent) clst = 2;
+	i = clst / 32;
+	w = FatCache.freemap[i] & (0xFFFFFFFF << (clst % 32));
+	for (n = 0; n <= nw; n++) {		/* Scan 32 clusters per step, wrap around once */
+		if (w) {
+			for (clst = i * 32; !(w & 1); w >>= 1) clst++;
+			return clst;
+		}
+		if (++i >= nw) i = 0;
+		w = FatCache.freemap[i];
+	}
+	return 0;
+}
+
+
+static DWORD fatc_find_run (	/* 0xFFFFFFFF:Not found, else first bit of the run */
+	const DWORD* map,	/* Bitmap to scan */
+	DWORD inv,			/* 0:Bit set means in use, 0xFFFFFFFF:Bit set means free */
+	DWORD nbit,			/* Number of valid bits */
+	DWORD start,		/* Bit to scan from */
+	DWORD ncl			/* Number of contiguous free bits to find (1..) */
+)
+{
+	DWORD val, scl, ctr, remain, w;
+
+
+	if (start >= nbit) start = 0;
+	val = scl = start; ctr = 0;
+	for (remain = nbit; remain; ) {
+		if (val >= nbit) {	/* Wrap-around, a run cannot span it */
+			val = 0; ctr = 0;
+		}
+		w = map[val / 32] ^ inv;	/* 1:In use */
+		if (!(val % 32) && remain >= 32 && val + 32 <= nbit && (w == 0 || w == 0xFFFFFFFF)) {	/* 32 bits per step */
+			if (w) {
+				ctr = 0;
+			} else {
+				if (ctr == 0) scl = val;
+				if (ctr + 32 >= ncl) return scl;
+				ctr += 32;
+			}
+			val += 32; remain -= 32;
+			continue;
+		}
+		if (w & (1U << (val % 32))) {
+			ctr = 0;
+		} else {
+			if (ctr++ == 0) scl = val;
+			if (ctr == ncl) return scl;
+		}
+		val++; remain--;
+	}
+	return 0xFFFFFFFF;
+}
+
+
+#if FF_FS_EXFAT
+static DWORD bmc_find (	/* 0:Not found, 2..:Cluster block found */
+	FATFS* fs,	/* Filesystem object */
+	DWORD clst,	/* Cluster number to scan from */
+	DWORD ncl	/* Number of contiguous clusters to find (1..) */
+)
+{
+	DWORD val;
+
+
+	/* The first bit in the bitmap corresponds to cluster #2 */
+	val = fatc_find_run(FatCache.tbl, 0, fs->n_fatent - 2, clst - 2, ncl);
+	return (val == 0xFFFFFFFF) ? 0 : val + 2;
+}
+
+
+static FRESULT bmc_change (
+	FATFS* fs,	/* Filesystem object */
+	DWORD clst,	/* Cluster number to change from */
+	DWORD ncl,	/* Number of clusters to be changed */
+	int bv		/* bit value to be set (0 or 1) */
+)
+{
+	DWORD val, n, m;
+
+
+	clst -= 2;	/* The first bit corresponds to cluster #2 */
+	for (val = clst, n = ncl; n; val += m, n -= m) {
+		if (!(val % 32) && n >= 32) {	/* Whole word */
+			if (FatCache.tbl[val / 32] != (bv ? 0 : 0xFFFFFFFF)) return FR_INT_ERR;
+			FatCache.tbl[val / 32] = bv ? 0xFFFFFFFF : 0;
+			m = 32;
+		} else {
+			if (bv == (int)((FatCache.tbl[val / 32] & (1U << (val % 32))) != 0)) return FR_INT_ERR;	/* Is the bit expected value? */
+			FatCache.tbl[val / 32] ^= 1U << (val % 32);
+			m = 1;
+		}
+	}
+	fatc_set_dirty(clst / 8 / SS(fs), (clst + ncl - 1) / 8 / SS(fs));	/* One write per sector at sync */
+
+	return FR_OK;
+}
+#endif
+
+
+static FRESULT fatc_flush (	/* FR_OK(0):succeeded, !=0:error */
+	FATFS* fs		/* Filesystem object */
+)
+{
+	DWORD sect, end, n;
+
+
+	if (FatCache.fs != fs) return FR_OK;
+
+	for (sect = FatCache.dlo; sect < FatCache.dhi; sect = end) {
+		if (!(FatCache.dirty[sect / 32] & (1U << (sect % 32)))) {	/* Skip clean sectors (whole words if possible) */
+			end = (FatCache.dirty[sect / 32] >> (sect % 32)) ? sect + 1 : (sect | 31) + 1;
+			continue;
+		}
+		for (end = sect; end < FatCache.dhi && end - sect < 0x4000 && (FatCache.dirty[end / 32] & (1U << (end % 32))); end++) {
+			FatCache.dirty[end / 32] &= ~(1U << (end % 32));
+		}
+		n = end - sect;
+		if (disk_write(fs->pdrv, (BYTE*)FatCache.tbl + sect * SS(fs), FatCache.base + sect, n) != RES_OK) return FR_DISK_ERR;
+		if (fs->fs_type == FS_FAT32 && fs->n_fats == 2) {	/* Reflect it to 2nd FAT */
+			if (disk_write(fs->pdrv, (BYTE*)FatCache.tbl + sect * SS(fs), fs->fatbase + fs->fsize + sect, n) != RES_OK) return FR_DISK_ERR;
+		}
+	}
+	FatCache.dlo = FatCache.nsect; FatCache.dhi = 0;
+
+	return FR_OK;
+}
+#endif
+
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Synchronize filesystem and data on the storage                        */
@@ -1129,7 +1434,12 @@ static FRESULT sync_fs (	/* Returns FR_OK or FR_DISK_ERR */
 	FRESULT res;
 
 
+#if FF_FAT_CACHE
+	res = fatc_flush(fs);	/* Write back dirty FAT sectors */
+	if (res == FR_OK) res = sync_window(fs);
+#else
 	res = sync_window(fs);
+#endif
 	if (res == FR_OK) {
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {	/* FAT32: Update FSInfo sector if needed */
 			/* Create FSInfo structure */
@@ -1208,6 +1518,12 @@ static DWORD get_fat (		/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFF
 			break;
 
 		case FS_FAT32 :
+#if FF_FAT_CACHE && !FF_FS_READONLY
+			if (FatCache.fs == fs) {	/* Resident FAT */
+				val = FatCache.tbl[clst] & 0x0FFFFFFF;
+				break;
+			}
+#endif
 			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
 			val = ld_dword(fs->win + clst * 4 % SS(fs)) & 0x0FFFFFFF;	/* Simple DWORD array but mask out upper 4 bits */
 			break;
@@ -1290,6 +1606,13 @@ static FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 		case FS_FAT32 :
 #if FF_FS_EXFAT
 		case FS_EXFAT :
+#endif
+#if FF_FAT_CACHE
+			if (FatCache.fs == fs && fs->fs_type == FS_FAT32) {	/* Resident FAT */
+				fatc_put(fs, clst, val);
+				res = FR_OK;
+				break;
+			}
 #endif
 			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
 			if (res != FR_OK) break;
@@ -1329,6 +1652,10 @@ static DWORD find_bitmap (	/* 0:Not found, 2..:Cluster block found, 0xFFFFFFFF:D
 	DWORD val, scl, ctr;
 
 
+#if FF_FAT_CACHE
+	if (FatCache.fs == fs) return bmc_find(fs, clst, ncl);	/* Resident bitmap */
+#endif
+
 	clst -= 2;	/* The first bit in the bitmap corresponds to cluster #2 */
 	if (clst >= fs->n_fatent - 2) clst = 0;
 	scl = val = clst; ctr = 0;
@@ -1370,6 +1697,10 @@ static FRESULT change_bitmap (
 	DWORD sect;
 
 
+#if FF_FAT_CACHE
+	if (FatCache.fs == fs) return bmc_change(fs, clst, ncl, bv);	/* Resident bitmap */
+#endif
+
 	clst -= 2;	/* The first bit corresponds to cluster #2 */
 	sect = fs->bitbase + clst / 8 / SS(fs);	/* Sector address */
 	i = clst / 8 % SS(fs);					/* Byte offset in the sector */
@@ -1600,6 +1931,12 @@ static DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:D
 				ncl = 0;
 			}
 		}
+#if FF_FAT_CACHE
+		if (ncl == 0 && FatCache.fs == fs) {	/* Find a free cluster in the bitmap */
+			ncl = fatc_find_free(fs, scl);
+			if (ncl == 0) return 0;
+		}
+#endif
 		if (ncl == 0) {	/* The new cluster cannot be contiguous and find another fragment */
 			ncl = scl;	/* Start cluster */
 			for (;;) {
@@ -1819,6 +2156,46 @@ static FRESULT dir_next (	/* FR_OK(0):succeeded, FR_NO_FILE:End of table, FR_DEN
 /* Directory handling - Reserve a block of directory entries             */
 /*-----------------------------------------------------------------------*/
 
+#if FF_DIR_HINTS
+static struct {
+	WORD id;		/* Volume mount ID (0:Unused) */
+	DWORD sclust;	/* Directory start cluster */
+	DWORD ofs;		/* Offset after the last allocated block */
+} DirHint[FF_DIR_HINTS];
+static UINT DirHintNext;
+
+static DWORD dir_hint_get (	/* Offset to start the free entry search at */
+	DIR* dp
+)
+{
+	UINT i;
+
+	for (i = 0; i < FF_DIR_HINTS; i++) {
+		if (DirHint[i].id == dp->obj.fs->id && DirHint[i].sclust == dp->obj.sclust) return DirHint[i].ofs;
+	}
+	return 0;
+}
+
+static void dir_hint_set (
+	DIR* dp,
+	DWORD ofs		/* Offset after the allocated block */
+)
+{
+	UINT i;
+
+	for (i = 0; i < FF_DIR_HINTS; i++) {
+		if (DirHint[i].id == dp->obj.fs->id && DirHint[i].sclust == dp->obj.sclust) break;
+	}
+	if (i == FF_DIR_HINTS) {	/* Replace the oldest one */
+		i = DirHintNext;
+		DirHintNext = (DirHintNext + 1) % FF_DIR_HINTS;
+		DirHint[i].id = dp->obj.fs->id;
+		DirHint[i].sclust = dp->obj.sclust;
+	}
+	DirHint[i].ofs = ofs;
+}
+#endif
+
 static FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 	DIR* dp,				/* Pointer to the directory object */
 	UINT nent				/* Number of contiguous entries to allocate */
@@ -1829,7 +2206,14 @@ static FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 	FATFS *fs = dp->obj.fs;
 
 
+#if FF_DIR_HINTS
+	DWORD ofs = dir_hint_get(dp);	/* Skip the entries known to be in use */
+
+	res = dir_sdi(dp, ofs);
+	if (res != FR_OK && ofs != 0) res = dir_sdi(dp, 0);
+#else
 	res = dir_sdi(dp, 0);
+#endif
 	if (res == FR_OK) {
 		n = 0;
 		do {
@@ -1848,6 +2232,9 @@ static FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 		} while (res == FR_OK);	/* Next entry with table stretch enabled */
 	}
 
+#if FF_DIR_HINTS
+	if (res == FR_OK) dir_hint_set(dp, dp->dptr + SZDIRE);
+#endif
 	if (res == FR_NO_FILE) res = FR_DENIED;	/* No directory entry to allocate */
 	return res;
 }
@@ -2176,6 +2563,7 @@ static void get_xfileinfo (
 	fno->fsize = (fno->fattrib & AM_DIR) ? 0 : ld_qword(dirb + XDIR_FileSize);	/* Size */
 	fno->ftime = ld_word(dirb + XDIR_ModTime + 0);	/* Time */
 	fno->fdate = ld_word(dirb + XDIR_ModTime + 2);	/* Date */
+	fno->fclust = ld_dword(dirb + XDIR_FstClus);	/* Start cluster */
 }
 
 #endif	/* FF_FS_MINIMIZE <= 1 || FF_FS_RPATH >= 2 */
@@ -2634,7 +3022,12 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 	FATFS *fs = dp->obj.fs;
 #if FF_USE_LFN		/* LFN configuration */
 	DWORD last = dp->dptr;
+#endif
 
+#if FF_DIR_HINTS
+	mem_set(DirHint, 0, sizeof DirHint);	/* Freed entries may be reused again */
+#endif
+#if FF_USE_LFN
 	res = (dp->blk_ofs == 0xFFFFFFFF) ? FR_OK : dir_sdi(dp, dp->blk_ofs);	/* Goto top of the entry block if LFN is exist */
 	if (res == FR_OK) {
 		do {
@@ -2767,6 +3160,7 @@ static void get_fileinfo (
 	fno->fsize = ld_dword(dp->dir + DIR_FileSize);		/* Size */
 	fno->ftime = ld_word(dp->dir + DIR_ModTime + 0);	/* Time */
 	fno->fdate = ld_word(dp->dir + DIR_ModTime + 2);	/* Date */
+	fno->fclust = ld_clust(dp->obj.fs, dp->dir);		/* Start cluster */
 }
 
 #endif /* FF_FS_MINIMIZE <= 1 || FF_FS_RPATH >= 2 */
@@ -3485,6 +3879,12 @@ static FRESULT find_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 
 	fs->fs_type = fmt;		/* FAT sub-type */
 	fs->id = ++Fsid;		/* Volume mount ID */
+#if FF_DIR_HINTS
+	mem_set(DirHint, 0, sizeof DirHint);	/* Drop the free entry cursors */
+#endif
+#if FF_FAT_CACHE && !FF_FS_READONLY
+	if (fmt == FS_FAT32 || fmt == FS_EXFAT) fatc_load(fs);	/* Read the FAT or allocation bitmap into DRAM */
+#endif
 #if FF_USE_LFN == 1
 	fs->lfnbuf = LfnBuf;	/* Static LFN working buffer */
 #if FF_FS_EXFAT
@@ -3579,6 +3979,9 @@ FRESULT f_mount (
 		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
 #endif
 		cfs->fs_type = 0;				/* Clear old fs object */
+#if FF_FAT_CACHE && !FF_FS_READONLY
+		if (FatCache.fs == cfs) FatCache.fs = 0;	/* Drop the resident FAT */
+#endif
 	}
 
 	if (fs) {
@@ -5707,6 +6110,22 @@ FRESULT f_expand (
 			}
 		}
 	} else
+#endif
+#if FF_FAT_CACHE
+	if (FatCache.fs == fs) {	/* Scan the free cluster bitmap */
+		scl = fatc_find_run(FatCache.freemap, 0xFFFFFFFF, fs->n_fatent, stcl, tcl);
+		if (scl == 0xFFFFFFFF) res = FR_DENIED;
+		if (res == FR_OK) {
+			if (opt) {
+				for (clst = scl, n = tcl; n; clst++, n--) {	/* Create a cluster chain on the FAT */
+					fatc_put(fs, clst, (n == 1) ? 0xFFFFFFFF : clst + 1);
+				}
+				lclst = scl + tcl - 1;
+			} else {
+				lclst = scl - 1;
+			}
+		}
+	} else
 #endif
 	{
 		scl = clst = stcl; ncl = 0;
@@ -5752,6 +6171,70 @@ FRESULT f_expand (
 	LEAVE_FF(fs, res);
 }
 
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Suggest a Contiguous Region for the Next Allocations                  */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_alloc_hint (
+	const TCHAR* path,	/* Logical drive number */
+	FSIZE_t fsz,		/* Total size of the data to be placed */
+	DWORD nobj			/* Number of files and directories (each may waste a cluster) */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	FFOBJID obj;
+	DWORD n, clst, stcl, scl, ncl, tcl;
+
+
+	res = find_volume(&path, &fs, FA_WRITE);	/* Get logical drive */
+	if (res != FR_OK) LEAVE_FF(fs, res);
+	n = (DWORD)fs->csize * SS(fs);	/* Cluster size */
+	tcl = (DWORD)(fsz / n) + nobj;	/* Upper bound of clusters required */
+	if (tcl == 0 || tcl > fs->n_fatent - 2) LEAVE_FF(fs, FR_INVALID_PARAMETER);
+	stcl = fs->last_clst;
+	if (stcl < 2 || stcl >= fs->n_fatent) stcl = 2;
+	obj.fs = fs;
+
+#if FF_FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {
+		scl = find_bitmap(fs, stcl, tcl);
+		if (scl == 0) res = FR_DENIED;
+		if (scl == 0xFFFFFFFF) res = FR_DISK_ERR;
+	} else
+#endif
+#if FF_FAT_CACHE
+	if (FatCache.fs == fs) {
+		scl = fatc_find_run(FatCache.freemap, 0xFFFFFFFF, fs->n_fatent, stcl, tcl);
+		if (scl == 0xFFFFFFFF) res = FR_DENIED;
+	} else
+#endif
+	{
+		scl = clst = stcl; ncl = 0;
+		for (;;) {	/* Find a contiguous cluster block */
+			n = get_fat(&obj, clst);
+			if (++clst >= fs->n_fatent) clst = 2;
+			if (n == 1) { res = FR_INT_ERR; break; }
+			if (n == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+			if (n == 0) {	/* Is it a free cluster? */
+				if (++ncl == tcl) break;
+			} else {
+				scl = clst; ncl = 0;
+			}
+			if (clst == stcl) { res = FR_DENIED; break; }
+		}
+	}
+
+	if (res == FR_OK) {
+		fs->last_clst = scl - 1;	/* Next-fit allocations start at the region */
+	}
+
+	LEAVE_FF(fs, res);
+}
+
 #endif /* FF_USE_EXPAND && !FF_FS_READONLY */
 
 
@@ -120,6 +120,7 @@ static void _heap_free(heap_t *heap, u32 addr)
 }
 
 heap_t _heap;
+static u32 _heap_calls = 0;
 
 void heap_init(u32 base)
 {
@@ -133,11 +134,13 @@ void heap_copy(heap_t *heap)
 
 void *malloc(u32 size)
 {
+	_heap_calls++;
 	return (void *)_heap_alloc(&_heap, size);
 }
 
 void *calloc(u32 num, u32 size)
 {
+	_heap_calls++;
 	void *res = (void *)_heap_alloc(&_heap, num * size);
 	memset(res, 0, ALIGN(num * size, sizeof(hnode_t))); // Clear the aligned size.
 	return res;
@@ -145,6 +148,7 @@ void *calloc(u32 num, u32 size)
 
 void free(void *buf)
 {
+	_heap_calls++;
 	if ((u32)buf >= _heap.start)
 		_heap_free(&_heap, (u32)buf);
 }
@@ -174,4 +178,5 @@ void heap_monitor(heap_monitor_t *mon, bool print_node_stats)
 			break;
 	}
 	mon->total += mon->used;
+	mon->calls = _heap_calls;
 }
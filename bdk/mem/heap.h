@@ -39,13 +39,18 @@ typedef struct
 {
     u32 total;
     u32 used;
+    u32 calls; // malloc/calloc/free calls so far
 } heap_monitor_t;
 
 void heap_init(u32 base);
 void heap_copy(heap_t *heap);
+#ifdef __x86_64__ /* Host build, the C library heap is wrapped */
+#include <stdlib.h>
+#else
 void *malloc(u32 size);
 void *calloc(u32 num, u32 size);
 void free(void *buf);
+#endif
 void heap_monitor(heap_monitor_t *mon, bool print_node_stats);
 
 #endif
@@ -40,6 +40,7 @@ typedef struct _irq_ctxt_t
 
 bool irq_init_done = false;
 irq_ctxt_t irqs[IRQ_MAX_HANDLERS];
+static u32 *irq_frame = NULL;
 
 static void _irq_enable_source(u32 irq)
 {
@@ -145,7 +146,7 @@ static irq_status_t _irq_handle_source(u32 irq)
 	return status;
 }
 
-void irq_handler()
+void irq_handler(u32 *frame)
 {
 	// Get IRQ source.
 	u32 irq = EXCP_VEC(EVP_COP_IRQ_STS) & 0xFF;
@@ -160,7 +161,10 @@ void irq_handler()
 
 	DPRINTF("IRQ: %d\n", irq);
 
+	// Saved R0-R3, R12, LR, return address and SPSR of the interrupted code.
+	irq_frame = frame;
 	int err = _irq_handle_source(irq);
+	irq_frame = NULL;
 
 	if (err == IRQ_NONE)
 	{
@@ -175,6 +179,11 @@ static void _irq_init()
 	irq_init_done = true;
 }
 
+u32 irq_get_ret_addr()
+{
+	return irq_frame ? irq_frame[6] : 0;
+}
+
 void irq_end()
 {
 	if (!irq_init_done)
@@ -213,6 +213,8 @@ typedef enum _irq_flags_t
 	IRQ_FLAG_REPLACEABLE = BIT(1)
 } irq_flags_t;
 
+void irq_setup_vectors();
+u32  irq_get_ret_addr(); // Where the interrupted code resumes. Only valid in a handler.
 void irq_end();
 void irq_free(u32 irq);
 void irq_wait_event();
@@ -48,9 +48,13 @@ bool sd_get_card_removed();
 bool sd_get_card_initialized();
 bool sd_get_card_mounted();
 u32  sd_get_mode();
+void sd_set_mode(u32 mode, u32 skip_mask);
 int  sd_init_retry(bool power_cycle);
 bool sd_initialize(bool power_cycle);
 bool sd_mount();
+bool sd_cache_enable();
+bool sd_cache_flush();
+bool sd_trim_flush();
 void sd_unmount();
 void sd_end();
 bool sd_is_gpt();
@@ -22,6 +22,9 @@
 /* class 5 */
 #define SD_ERASE_WR_BLK_START    32 /* ac   [31:0] data addr   R1  */
 #define SD_ERASE_WR_BLK_END      33 /* ac   [31:0] data addr   R1  */
+/* class 11 */
+#define SD_READ_EXTR_SINGLE      48 /* adtc [31:0]             R1  */
+#define SD_WRITE_EXTR_SINGLE     49 /* adtc [31:0]             R1  */
 
 /* Application commands */
 #define SD_APP_SET_BUS_WIDTH             6 /* ac   [1:0] bus width    R1  */
@@ -92,6 +95,24 @@
 #define SCR_SPEC_VER_2		2	/* Implements system specification 2.00-3.0X */
 #define SD_SCR_BUS_WIDTH_1	(1<<0)
 #define SD_SCR_BUS_WIDTH_4	(1<<2)
+#define SD_SCR_CMD20_SUPPORT	(1<<0)
+#define SD_SCR_CMD23_SUPPORT	(1<<1)
+#define SD_SCR_CMD48_SUPPORT	(1<<2)
+#define SD_SCR_CMD58_SUPPORT	(1<<3)
+
+/*
+ * SD extension registers (CMD48/CMD49)
+ */
+#define SD_EXT_SFC_PERF			2	/* Performance Enhancement function */
+#define SD_EXT_PERF_CACHE_EN	260	/* Cache Enable, bit 0 */
+#define SD_EXT_PERF_CACHE_FLUSH	261	/* Cache Flush, bit 0 */
+#define SD_EXT_CACHE_FLUSH_TIMEOUT	1000	/* ms */
+
+/*
+ * SD erase arguments (CMD38)
+ */
+#define SD_ERASE_ARG		0x00000000
+#define SD_DISCARD_ARG		0x00000001
 
 /*
  * SD bus widths
@@ -884,7 +884,7 @@ static void _sd_storage_parse_scr(sdmmc_storage_t *storage)
 	if (storage->scr.sda_vsn == SCR_SPEC_VER_2)
 		storage->scr.sda_spec3 = unstuff_bits(resp, 47, 1);
 	if (storage->scr.sda_spec3)
-		storage->scr.cmds = unstuff_bits(resp, 32, 2);
+		storage->scr.cmds = unstuff_bits(resp, 32, 4);
 }
 
 int _sd_storage_get_scr(sdmmc_storage_t *storage, u8 *buf)
@@ -1206,6 +1206,7 @@ static void _sd_storage_parse_ssr(sdmmc_storage_t *storage)
 	storage->ssr.uhs_grade =   unstuff_bits(raw_ssr1, 396 - 384, 4);
 	storage->ssr.video_class = unstuff_bits(raw_ssr1, 384 - 384, 8);
 	storage->ssr.app_class =   unstuff_bits(raw_ssr2, 336 - 256, 4);
+	storage->ssr.discard =     unstuff_bits(raw_ssr2, 313 - 256, 1);
 
 	storage->ssr.au_size =     unstuff_bits(raw_ssr1, 428 - 384, 4);
 	storage->ssr.uhs_au_size = unstuff_bits(raw_ssr1, 392 - 384, 4);
@@ -1251,6 +1252,186 @@ DPRINTF("[SD] ssr: Not supported\n");
 	return _sdmmc_storage_check_card_status(tmp);
 }
 
+static int _sd_storage_ext_reg_xfer(sdmmc_storage_t *storage, u8 *buf, u32 fno, u32 page, u32 offset, u32 len, u32 is_write)
+{
+	sdmmc_cmd_t cmdbuf;
+	u32 arg = (fno << 27) | (page << 18) | (offset << 9) | (len - 1);
+	sdmmc_init_cmd(&cmdbuf, is_write ? SD_WRITE_EXTR_SINGLE : SD_READ_EXTR_SINGLE, arg, SDMMC_RSP_TYPE_1, 0);
+
+	sdmmc_req_t reqbuf;
+	reqbuf.buf = buf;
+	reqbuf.blksize = 512;
+	reqbuf.num_sectors = 1;
+	reqbuf.is_write = is_write;
+	reqbuf.is_multi_block = 0;
+	reqbuf.is_auto_stop_trn = 0;
+
+	if (!sdmmc_execute_cmd(storage->sdmmc, &cmdbuf, &reqbuf, NULL))
+		return 0;
+
+	u32 tmp = 0;
+	sdmmc_get_rsp(storage->sdmmc, &tmp, 4, SDMMC_RSP_TYPE_1);
+
+	return _sdmmc_storage_check_card_status(tmp);
+}
+
+static int _sd_storage_ext_reg_write_byte(sdmmc_storage_t *storage, u8 *buf, u32 offset, u8 val, u32 timeout_ms)
+{
+	memset(buf, 0, 512);
+	buf[0] = val;
+
+	if (!_sd_storage_ext_reg_xfer(storage, buf, storage->ext_perf.fno, storage->ext_perf.page, offset, 1, 1))
+		return 0;
+
+	// Wait for the card to leave programming state.
+	u32 resp = -1;
+	u32 timeout = get_tmr_ms() + timeout_ms;
+	while (resp != (R1_READY_FOR_DATA | R1_STATE(R1_STATE_TRAN)))
+	{
+		_sdmmc_storage_get_status(storage, &resp, 0);
+
+		if (get_tmr_ms() > timeout)
+			break;
+	}
+
+	return _sdmmc_storage_check_card_status(resp);
+}
+
+static void _sd_storage_parse_ext_perf(sdmmc_storage_t *storage, u8 *buf)
+{
+	storage->ext_perf.valid = 0;
+	storage->ext_perf.cache = 0;
+
+	if (!(storage->scr.cmds & SD_SCR_CMD48_SUPPORT))
+		return;
+
+	// Read General Information page.
+	if (!_sd_storage_ext_reg_xfer(storage, buf, 0, 0, 0, 512, 0))
+		return;
+
+	u16 rev = buf[0] | (buf[1] << 8);
+	u16 len = buf[2] | (buf[3] << 8);
+	u32 num_ext = buf[4];
+	if (rev || len > 512)
+		return;
+
+	// Walk extension descriptors and find Performance Enhancement.
+	u32 ext_addr = 16;
+	while (num_ext--)
+	{
+		if (ext_addr + 48 > 512)
+			return;
+
+		u16 sfc      = buf[ext_addr] | (buf[ext_addr + 1] << 8);
+		u16 next     = buf[ext_addr + 40] | (buf[ext_addr + 41] << 8);
+		u8  num_regs = buf[ext_addr + 42];
+		u32 reg_addr = buf[ext_addr + 44] | (buf[ext_addr + 45] << 8) | (buf[ext_addr + 46] << 16) | (buf[ext_addr + 47] << 24);
+
+		// Cache registers must fit in the same page.
+		if (sfc == SD_EXT_SFC_PERF && num_regs == 1 && (reg_addr & 0x1FF) + SD_EXT_PERF_CACHE_FLUSH < 512)
+		{
+			storage->ext_perf.fno    = (reg_addr >> 18) & 0xF;
+			storage->ext_perf.page   = (reg_addr >> 9) & 0x1FF;
+			storage->ext_perf.offset = reg_addr & 0x1FF;
+			storage->ext_perf.valid  = 1;
+			break;
+		}
+
+		if (!next)
+			return;
+		ext_addr = next;
+	}
+
+	if (!storage->ext_perf.valid)
+		return;
+
+	// Read Performance Enhancement register set.
+	if (!_sd_storage_ext_reg_xfer(storage, buf, storage->ext_perf.fno, storage->ext_perf.page, storage->ext_perf.offset, 512 - storage->ext_perf.offset, 0))
+		return;
+
+	storage->ext_perf.cache = buf[4] & BIT(0);
+}
+
+int sd_storage_enable_cache(sdmmc_storage_t *storage, u8 *buf)
+{
+	if (storage->ext_perf.cache_en)
+		return 1;
+
+	_sd_storage_parse_ext_perf(storage, buf);
+	if (!storage->ext_perf.cache)
+	{
+DPRINTF("[SD] cache: Not supported\n");
+		return 0;
+	}
+
+	if (!_sd_storage_ext_reg_write_byte(storage, buf, storage->ext_perf.offset + SD_EXT_PERF_CACHE_EN, BIT(0), 1000))
+		return 0;
+
+	storage->ext_perf.cache_en = 1;
+
+	return 1;
+}
+
+int sd_storage_flush_cache(sdmmc_storage_t *storage, u8 *buf)
+{
+	if (!storage->ext_perf.cache_en)
+		return 1;
+
+	u32 offset = storage->ext_perf.offset + SD_EXT_PERF_CACHE_FLUSH;
+	if (!_sd_storage_ext_reg_write_byte(storage, buf, offset, BIT(0), SD_EXT_CACHE_FLUSH_TIMEOUT))
+		return 0;
+
+	// The card clears the flush bit once the cache is written back.
+	if (!_sd_storage_ext_reg_xfer(storage, buf, storage->ext_perf.fno, storage->ext_perf.page, offset, 1, 0))
+		return 0;
+
+	return !(buf[0] & BIT(0));
+}
+
+int sd_storage_erase(sdmmc_storage_t *storage, u32 sector, u32 num_sectors)
+{
+	if (!(storage->csd.cmdclass & CCC_ERASE) || !num_sectors)
+		return 0;
+
+	u32 start = sector;
+	u32 end = sector + num_sectors - 1;
+
+	// If SDSC convert block address to byte address.
+	if (!storage->has_sector_access)
+	{
+		start <<= 9;
+		end <<= 9;
+	}
+
+	if (!_sdmmc_storage_execute_cmd_type1(storage, SD_ERASE_WR_BLK_START, start, 0, R1_STATE_TRAN))
+		return 0;
+
+	if (!_sdmmc_storage_execute_cmd_type1(storage, SD_ERASE_WR_BLK_END, end, 0, R1_STATE_TRAN))
+		return 0;
+
+	// Discard only marks the blocks as unused, which is all that's needed.
+	u32 arg = storage->ssr.discard ? SD_DISCARD_ARG : SD_ERASE_ARG;
+	if (!_sdmmc_storage_execute_cmd_type1(storage, MMC_ERASE, arg, 0, R1_SKIP_STATE_CHECK))
+		return 0;
+
+	// Erase can take longer than the controller busy timeout. Poll status instead (250ms per AU).
+	u32 au = sd_storage_get_ssr_au(storage) * 2;
+	if (!au)
+		au = 32768;
+
+	u32 resp = -1;
+	u32 timeout = get_tmr_ms() + 1000 + 250 * DIV_ROUND_UP(num_sectors, au);
+	while (resp != (R1_READY_FOR_DATA | R1_STATE(R1_STATE_TRAN)))
+	{
+		_sdmmc_storage_get_status(storage, &resp, 0);
+
+		if (get_tmr_ms() > timeout)
+			break;
+	}
+
+	return _sdmmc_storage_check_card_status(resp);
+}
+
 static void _sd_storage_parse_cid(sdmmc_storage_t *storage)
 {
 	u32 *raw_cid = (u32 *)&(storage->raw_cid);
@@ -164,6 +164,16 @@ typedef struct _sd_scr
 	u8 cmds;
 } sd_scr_t;
 
+typedef struct _sd_ext_reg_t
+{
+	u8  valid;
+	u8  fno;
+	u16 page;
+	u16 offset;
+	u8  cache;
+	u8  cache_en;
+} sd_ext_reg_t;
+
 typedef struct _sd_ssr
 {
 	u8  bus_width;
@@ -173,6 +183,7 @@ typedef struct _sd_ssr
 	u8  app_class;
 	u8  au_size;
 	u8  uhs_au_size;
+	u8  discard;
 	u32 protected_size;
 } sd_ssr_t;
 
@@ -195,6 +206,7 @@ typedef struct _sdmmc_storage_t
 	mmc_ext_csd_t ext_csd;
 	sd_scr_t      scr;
 	sd_ssr_t      ssr;
+	sd_ext_reg_t  ext_perf;
 } sdmmc_storage_t;
 
 int  sdmmc_storage_end(sdmmc_storage_t *storage);
@@ -211,5 +223,8 @@ int  sdmmc_storage_vendor_sandisk_report(sdmmc_storage_t *storage, void *buf);
 
 int  sd_storage_get_ssr(sdmmc_storage_t *storage, u8 *buf);
 u32  sd_storage_get_ssr_au(sdmmc_storage_t *storage);
+int  sd_storage_enable_cache(sdmmc_storage_t *storage, u8 *buf);
+int  sd_storage_flush_cache(sdmmc_storage_t *storage, u8 *buf);
+int  sd_storage_erase(sdmmc_storage_t *storage, u32 sector, u32 num_sectors);
 
 #endif
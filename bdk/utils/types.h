@@ -37,7 +37,11 @@ typedef unsigned short WORD;
 typedef unsigned short WCHAR;
 typedef unsigned int u32;
 typedef unsigned int UINT;
+#ifdef __x86_64__ /* Host build, FatFs needs a 32-bit DWORD */
+typedef unsigned int DWORD;
+#else
 typedef unsigned long DWORD;
+#endif
 typedef unsigned long long QWORD;
 typedef unsigned long long int u64;
 
@@ -45,7 +49,7 @@ typedef volatile unsigned char vu8;
 typedef volatile unsigned short vu16;
 typedef volatile unsigned int vu32;
 
-#ifdef __aarch64__
+#if defined(__aarch64__) || defined(__x86_64__)
 typedef u64 uptr;
 #else /* __arm__ or __thumb__ */
 typedef u32 uptr;
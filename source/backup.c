@@ -14,6 +14,18 @@ static bool path_exists(const char *path) {
     return (f_stat(path, &fno) == FR_OK);
 }
 
+// Size of the user data below root (sd:/switch or the backup folder)
+void user_data_size(const char *root, u64 *bytes, u32 *files) {
+    char path[64];
+
+    s_printf(path, "%s/DBI", root);
+    path_size(path, bytes, files);
+    s_printf(path, "%s/tinfoil", root);
+    path_size(path, bytes, files);
+    s_printf(path, "%s/prod.keys", root);
+    path_size(path, bytes, files);
+}
+
 // Backup user data before clean install
 int backup_user_data(void) {
     int res;
@@ -8,6 +8,10 @@
 
 #define TEMP_BACKUP_PATH "sd:/temp_backup"
 
+// Add the size and file count of DBI, Tinfoil and prod.keys below root
+// (sd:/switch before the backup, TEMP_BACKUP_PATH before the restore)
+void user_data_size(const char *root, u64 *bytes, u32 *files);
+
 // Backup user data (DBI, Tinfoil, prod.keys) before clean install
 int backup_user_data(void);
 
@@ -0,0 +1,374 @@
+/*
+ * OmniNX Installer - Source-ordered copy scheduling
+ *
+ * The staging tree is extracted onto a card that is usually far from empty, so
+ * its files end up scattered across the data area and copying them in readdir
+ * order makes the read side jump back and forth. The plan collects every file
+ * of a tree together with its start cluster, creates the destination
+ * directories up front and then copies the files sorted by cluster, which turns
+ * the reads into a forward sweep over the card.
+ *
+ * Copying file by file also alternates between reading and writing every
+ * chunk, and most cards pay for each switch. Files up to 1MB, which are the
+ * thousands of small files of a pack, are therefore read in one phase into an
+ * arena sized from the free heap and written out in a second phase.
+ */
+
+#include "copy_plan.h"
+#include "fs.h"
+#include "inventory.h"
+#include "progress.h"
+#include "verify.h"
+#include "worker.h"
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
+#include <memory_map.h>
+#include <string.h>
+#include <utils/sprintf.h>
+#include <utils/util.h>
+
+#define COPY_PLAN_BLK_SIZE 0x8000 // Path storage is allocated in 32KB blocks
+
+#define COPY_BATCH_FILE_MAX  0x100000  // Larger files are streamed by file_copy()
+#define COPY_BATCH_ARENA_MAX 0x4000000 // 64MB
+#define COPY_BATCH_ARENA_MIN 0x400000  // Below 4MB batching is not worth it
+#define COPY_BATCH_ALIGN     64        // Keep every file DMA and cache line aligned
+
+struct _copy_plan_blk_t {
+    copy_plan_blk_t *next;
+    u32 used;
+    char data[];
+};
+
+static const char *plan_store_path(copy_plan_t *plan, const char *path) {
+    u32 len = strlen(path) + 1;
+    copy_plan_blk_t *blk = plan->blks;
+
+    if (!blk || blk->used + len > COPY_PLAN_BLK_SIZE - sizeof(copy_plan_blk_t)) {
+        blk = malloc(COPY_PLAN_BLK_SIZE);
+        if (!blk)
+            return NULL;
+        blk->next = plan->blks;
+        blk->used = 0;
+        plan->blks = blk;
+    }
+
+    char *res = blk->data + blk->used;
+    memcpy(res, path, len);
+    blk->used += len;
+
+    return res;
+}
+
+// Create a directory, accepting an existing one but not a file in its place
+static int plan_mkdir(const char *path) {
+    FILINFO fno;
+    int res = f_mkdir(path);
+
+    if (res == FR_OK || res == FR_EXIST)
+        return FR_OK;
+
+    if (f_stat(path, &fno) == FR_OK)
+        return (fno.fattrib & AM_DIR) ? FR_OK : FR_DENIED;
+
+    return res;
+}
+
+static int plan_walk(copy_plan_t *plan, const char *rel) {
+    DIR dir;
+    FILINFO fno;
+    char path[256];
+    char dst[256];
+    char sub[256];
+    int res;
+
+    if (rel[0])
+        s_printf(path, "%s/%s", plan->src, rel);
+    else
+        strcpy(path, plan->src);
+
+    res = f_opendir(&dir, path);
+    if (res != FR_OK)
+        return res;
+
+    while (1) {
+        res = f_readdir(&dir, &fno);
+        if (res != FR_OK || fno.fname[0] == 0) break;
+
+        // Skip . and ..
+        if (fno.fname[0] == '.' && (fno.fname[1] == '\0' || (fno.fname[1] == '.' && fno.fname[2] == '\0')))
+            continue;
+
+        if (rel[0])
+            s_printf(sub, "%s/%s", rel, fno.fname);
+        else
+            strcpy(sub, fno.fname);
+
+        if (fno.fattrib & AM_DIR) {
+            s_printf(path, "%s/%s", plan->dst, sub);
+            res = plan_mkdir(path);
+            if (res == FR_OK) {
+                plan->dirs++;
+                res = plan_walk(plan, sub);
+            }
+        } else {
+            s_printf(path, "%s/%s", plan->src, sub);
+            s_printf(dst, "%s/%s", plan->dst, sub);
+            if (inventory_unchanged(path, dst, (u32)fno.fsize)) {
+                plan->skipped++;
+                progress_add(fno.fsize, 1);
+            } else if (plan->count >= plan->cap) {
+                res = FR_NOT_ENOUGH_CORE;
+            } else {
+                copy_plan_entry_t *e = &plan->ents[plan->count];
+                e->path = plan_store_path(plan, sub);
+                e->clust = fno.fclust;
+                e->size = (u32)fno.fsize;
+                e->attr = fno.fattrib;
+                if (e->path)
+                    plan->count++;
+                else
+                    res = FR_NOT_ENOUGH_CORE;
+            }
+        }
+
+        if (res != FR_OK) break;
+    }
+
+    f_closedir(&dir);
+    return res;
+}
+
+static void plan_sift_down(copy_plan_entry_t *ents, u32 root, u32 count) {
+    while (root * 2 + 1 < count) {
+        u32 child = root * 2 + 1;
+        if (child + 1 < count && ents[child + 1].clust > ents[child].clust)
+            child++;
+        if (ents[root].clust >= ents[child].clust)
+            return;
+
+        copy_plan_entry_t tmp = ents[root];
+        ents[root] = ents[child];
+        ents[child] = tmp;
+        root = child;
+    }
+}
+
+// Heap sort by start cluster, no recursion and no extra memory
+static void plan_sort(copy_plan_entry_t *ents, u32 count) {
+    if (count < 2)
+        return;
+
+    for (u32 i = count / 2; i-- > 0;)
+        plan_sift_down(ents, i, count);
+
+    for (u32 end = count - 1; end > 0; end--) {
+        copy_plan_entry_t tmp = ents[0];
+        ents[0] = ents[end];
+        ents[end] = tmp;
+        plan_sift_down(ents, 0, end);
+    }
+}
+
+int copy_plan_build(copy_plan_t *plan, const char *src, const char *dst, int max_items) {
+    memset(plan, 0, sizeof(*plan));
+
+    const char *folder_name = strrchr(src, '/');
+    folder_name = folder_name ? folder_name + 1 : src;
+
+    u32 dst_len = strlen(dst);
+    strcpy(plan->src, src);
+    if (dst_len > 0 && dst[dst_len - 1] == '/')
+        s_printf(plan->dst, "%s%s", dst, folder_name);
+    else
+        s_printf(plan->dst, "%s/%s", dst, folder_name);
+
+    plan->cap = max_items > 0 ? max_items : 1;
+    plan->ents = malloc(plan->cap * sizeof(copy_plan_entry_t));
+    if (!plan->ents)
+        return FR_NOT_ENOUGH_CORE;
+
+    int res = plan_mkdir(plan->dst);
+    if (res == FR_OK)
+        res = plan_walk(plan, "");
+    if (res != FR_OK) {
+        copy_plan_free(plan);
+        return res;
+    }
+
+    plan_sort(plan->ents, plan->count);
+    log_write("PLAN: %s -> %s (%d files, %d dirs, %d unchanged)\n", plan->src, plan->dst, plan->count, plan->dirs, plan->skipped);
+
+    return FR_OK;
+}
+
+// Take half of the free heap, so the copy buffers and FatFs still have room
+static u8 *plan_alloc_arena(u32 *size) {
+    heap_monitor_t mon;
+    heap_monitor(&mon, false);
+
+    u32 free_sz = IPL_HEAP_SZ > mon.used ? IPL_HEAP_SZ - mon.used : 0;
+    u32 sz = ALIGN_DOWN(MIN(free_sz / 2, COPY_BATCH_ARENA_MAX), 0x100000);
+    if (sz < COPY_BATCH_ARENA_MIN)
+        return NULL;
+
+    *size = sz;
+    return malloc(sz);
+}
+
+static int plan_read_file(const char *path, u8 *buf, u32 size) {
+    FIL fp;
+    UINT br = 0;
+
+    int res = f_open(&fp, path, FA_READ | FA_OPEN_EXISTING);
+    if (res != FR_OK) {
+        log_write("  ERROR open src: %s\n", fs_error_str(res));
+        return res;
+    }
+
+    res = f_read(&fp, buf, size, &br);
+    f_close(&fp);
+
+    if (res == FR_OK && br != size) {
+        log_write("  ERROR: Read %d bytes, expected %d\n", br, size);
+        res = FR_DISK_ERR;
+    } else if (res != FR_OK) {
+        log_write("  ERROR read: %s\n", fs_error_str(res));
+    }
+
+    return res;
+}
+
+static int plan_write_file(const char *path, const u8 *buf, u32 size, u8 attr) {
+    FIL fp;
+    UINT bw = 0;
+    verify_sha_t sha;
+
+    int res = f_open(&fp, path, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) {
+        log_write("  ERROR open dst: %s\n", fs_error_str(res));
+        return res;
+    }
+
+    bool expanded = size && f_expand(&fp, size, 1) == FR_OK;
+
+    worker_crc32_begin(0, buf, size);
+    verify_begin(&sha, size);
+    verify_update(&sha, buf, size);
+    res = f_write(&fp, buf, size, &bw);
+    verify_wait(&sha);
+    u32 crc = worker_crc32_end();
+    if (res == FR_OK && bw != size) {
+        log_write("  ERROR: Wrote %d bytes, expected %d\n", bw, size);
+        res = FR_DISK_ERR;
+    } else if (res != FR_OK) {
+        log_write("  ERROR write: %s\n", fs_error_str(res));
+    }
+
+    // Don't leave preallocated garbage behind a failed copy
+    if (res != FR_OK && expanded) {
+        f_lseek(&fp, bw);
+        f_truncate(&fp);
+    }
+
+    if (res == FR_OK)
+        inventory_add(path, size, crc, fp.obj.sclust);
+    f_close(&fp);
+
+    if (res == FR_OK)
+        res = verify_end(&sha, path);
+
+    if (res == FR_OK) {
+        f_chmod(path, attr, 0x3A);
+        progress_add(size, 1);
+    }
+
+    return res;
+}
+
+// Copy the small files in batches: one read phase filling the arena, then one write phase
+static int plan_run_batched(copy_plan_t *plan, u8 *arena, u32 arena_sz) {
+    char path[256];
+    u32 i = 0;
+
+    while (i < plan->count) {
+        u32 used = 0;
+        u32 end;
+
+        for (end = i; end < plan->count; end++) {
+            copy_plan_entry_t *e = &plan->ents[end];
+            if (e->size > COPY_BATCH_FILE_MAX)
+                continue;
+            if (used + e->size > arena_sz)
+                break;
+
+            s_printf(path, "%s/%s", plan->src, e->path);
+            log_write("READ: %s (%d bytes)\n", path, e->size);
+            int res = plan_read_file(path, arena + used, e->size);
+            if (res != FR_OK)
+                return res;
+
+            used += ALIGN(e->size, COPY_BATCH_ALIGN);
+        }
+
+        used = 0;
+        for (; i < end; i++) {
+            copy_plan_entry_t *e = &plan->ents[i];
+            if (e->size > COPY_BATCH_FILE_MAX)
+                continue;
+
+            s_printf(path, "%s/%s", plan->dst, e->path);
+            log_write("WRITE: %s\n", path);
+            int res = plan_write_file(path, arena + used, e->size, e->attr);
+            if (res != FR_OK)
+                return res;
+
+            used += ALIGN(e->size, COPY_BATCH_ALIGN);
+        }
+    }
+
+    return FR_OK;
+}
+
+int copy_plan_run(copy_plan_t *plan) {
+    char src_full[256];
+    char dst_full[256];
+    int res = FR_OK;
+    u32 arena_sz = 0;
+    u8 *arena = plan_alloc_arena(&arena_sz);
+
+    if (arena) {
+        res = plan_run_batched(plan, arena, arena_sz);
+        free(arena);
+        if (res != FR_OK)
+            return res;
+    }
+
+    // Without an arena every file is streamed, otherwise only the large ones are left
+    for (u32 i = 0; i < plan->count; i++) {
+        if (arena && plan->ents[i].size <= COPY_BATCH_FILE_MAX)
+            continue;
+
+        s_printf(src_full, "%s/%s", plan->src, plan->ents[i].path);
+        s_printf(dst_full, "%s/%s", plan->dst, plan->ents[i].path);
+
+        res = file_copy(src_full, dst_full);
+        if (res != FR_OK)
+            break;
+    }
+
+    return res;
+}
+
+void copy_plan_free(copy_plan_t *plan) {
+    while (plan->blks) {
+        copy_plan_blk_t *next = plan->blks->next;
+        free(plan->blks);
+        plan->blks = next;
+    }
+
+    free(plan->ents);
+    plan->ents = NULL;
+    plan->count = 0;
+    plan->cap = 0;
+}
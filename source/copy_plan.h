@@ -0,0 +1,41 @@
+/*
+ * OmniNX Installer - Source-ordered copy scheduling
+ */
+
+#pragma once
+#include <utils/types.h>
+
+typedef struct {
+    u32 clust;        // Start cluster of the source file (0 for empty files)
+    u32 size;
+    u8  attr;
+    const char *path; // Path relative to the source root
+} copy_plan_entry_t;
+
+typedef struct _copy_plan_blk_t copy_plan_blk_t;
+
+typedef struct {
+    char src[256];          // Source root
+    char dst[256];          // Destination root (dst + source folder name)
+    copy_plan_entry_t *ents;
+    u32 count;
+    u32 cap;
+    u32 dirs;               // Destination directories created while building
+    u32 skipped;            // Files left out as unchanged (delta update)
+    copy_plan_blk_t *blks;  // Path string storage
+} copy_plan_t;
+
+// Walk src, create the matching directory tree under dst and collect every file
+// with its start cluster, sorted by it. Unchanged files are reported to the
+// progress line right away. max_items is the number of items counted
+// beforehand. Returns FR_NOT_ENOUGH_CORE if the list does not fit in memory, in
+// which case the caller should copy in directory order instead.
+int copy_plan_build(copy_plan_t *plan, const char *src, const char *dst, int max_items);
+
+// Copy all planned files in source cluster order. Small files are read in
+// batches into a DRAM arena and then written out together, larger ones are
+// streamed by file_copy() afterwards. Every written file is reported to the
+// progress line (progress_add()).
+int copy_plan_run(copy_plan_t *plan);
+
+void copy_plan_free(copy_plan_t *plan);
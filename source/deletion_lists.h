@@ -1,6 +1,7 @@
 /*
  * OmniNX Installer - Deletion Lists for Update Mode
  * Arrays of paths to delete during update installation
+ * Only used for installs without an inventory (see inventory.c)
  */
 
 #pragma once
@@ -0,0 +1,270 @@
+/*
+ * OmniNX Installer - Engine
+ *
+ * Everything between the stub's boot screen and chainloading hekate: pack
+ * detection, the prompts, the install and its summary. The stub loads this
+ * with ianos_loader() and calls _modInit() with an engine_cfg_t (engine.h).
+ *
+ * The engine has its own copy of the BDK. It takes over the stub's console
+ * and heap on entry and hands them back on return; the SD card is released by
+ * the stub's driver first and by ours at the end, so the stub can mount it
+ * again to chainload. The result says what the stub does next.
+ */
+
+#include "engine.h"
+
+#include <string.h>
+
+#include "gfx.h"
+#include <libs/fatfs/ff.h>
+#include <memory_map.h>
+#include <mem/heap.h>
+#include <module.h>
+#include "nx_sd.h"
+#include <utils/btn.h>
+#include <utils/util.h>
+#include <input/joycon.h>
+
+#include "fs.h"
+#include "install.h"
+#include "sd_profile.h"
+#include "sd_tuning.h"
+#include "worker.h"
+#include "profile.h"
+
+#ifndef VERSION
+#define VERSION "1.0.0"
+#endif
+
+#define COLOR_CYAN    0xFF00FFFF
+#define COLOR_WHITE   0xFFFFFFFF
+
+extern heap_t _heap;
+
+// Required by the BDK
+volatile nyx_storage_t *nyx_str = (nyx_storage_t *)NYX_STORAGE_ADDR;
+
+static int total_errors = 0;
+
+static void set_color(u32 color) {
+    gfx_con_setcol(color, gfx_con.fillbg, gfx_con.bgcol);
+}
+
+static void print_header(void) {
+    gfx_clear_grey(0x1B);
+    gfx_con_setpos(0, 0);
+    set_color(COLOR_CYAN);
+    gfx_printf("========================================\n");
+    gfx_printf("  OmniNX Installer Payload v%s\n", VERSION);
+    gfx_printf("========================================\n\n");
+    set_color(COLOR_WHITE);
+}
+
+static int file_exists(const char *path) {
+    FILINFO fno;
+    return (f_stat(path, &fno) == FR_OK);
+}
+
+// Wait for the A button (right Joy-Con) or the power button
+static void wait_for_confirm(void) {
+    // First, wait for power button to be released if it's currently pressed
+    while (btn_read() & BTN_POWER) {
+        msleep(50);
+    }
+
+    while (true) {
+        if (btn_read() & BTN_POWER)
+            break;
+
+        jc_gamepad_rpt_t *jc = joycon_poll();
+        if (jc && jc->a)
+            break;
+
+        msleep(50); // Small delay to avoid busy-waiting
+    }
+}
+
+static engine_result_t engine_run(void) {
+    if (!sd_mount())
+        return ENGINE_REBOOT;
+
+    // Skip bus modes this card is known to fail at
+    if (!sd_tuning_apply())
+        return ENGINE_REBOOT;
+
+    // Pick I/O parameters for this card before anything is written
+    sd_profile_init();
+
+    // Use the card's write cache if it has one (flushed at every phase boundary)
+    if (sd_profile_get()->use_cache)
+        sd_cache_enable();
+
+    // Detect current OmniNX installation
+    omninx_status_t current = detect_omninx_installation();
+
+    // Detect which pack variant is on SD card
+    omninx_variant_t pack_variant = detect_pack_variant();
+
+    // Initialize joycons for button input
+    jc_init_hw();
+
+    if (pack_variant == VARIANT_NONE) {
+        set_color(COLOR_RED);
+        gfx_printf("FEHLER: Kein OmniNX-Paket auf der SD-Karte gefunden!\n");
+        gfx_printf("Erwartet wird eines der folgenden:\n");
+        gfx_printf("  - sd:/OmniNX Standard/\n");
+        gfx_printf("  - sd:/OmniNX Light/\n");
+        gfx_printf("  - sd:/OmniNX OC/\n");
+        gfx_printf("  - sd:/OmniNX-*.zip\n\n");
+        set_color(COLOR_WHITE);
+
+        bool have_payload = file_exists(PAYLOAD_PATH);
+
+        set_color(COLOR_GREEN);
+        gfx_printf("Druecke A-Taste (rechter Joy-Con) oder Power-Taste,\n");
+        gfx_printf(have_payload ? "um Hekate zu starten...\n" : "um den Neustart zu starten...\n");
+        set_color(COLOR_WHITE);
+
+        wait_for_confirm();
+
+        // Launch payload if available, otherwise reboot
+        if (!have_payload)
+            return ENGINE_REBOOT;
+
+        gfx_printf("\n");
+        set_color(COLOR_CYAN);
+        gfx_printf("Payload wird gestartet...\n");
+        set_color(COLOR_WHITE);
+        msleep(500);
+        return ENGINE_LAUNCH;
+    }
+
+    // Determine installation mode
+    install_mode_t mode = current.is_installed ? INSTALL_MODE_UPDATE : INSTALL_MODE_CLEAN;
+
+    // Show information
+    set_color(COLOR_CYAN);
+    gfx_printf("Installationsmodus: %s\n", mode == INSTALL_MODE_UPDATE ? "Update" : "Saubere Installation");
+    gfx_printf("Paket-Variante: %s\n", get_variant_name(pack_variant));
+    if (current.is_installed) {
+        gfx_printf("Aktuelle Installation: %s\n", get_variant_name(current.variant));
+    } else {
+        gfx_printf("Aktuelle Installation: Keine\n");
+    }
+    set_color(COLOR_WHITE);
+    gfx_printf("\n");
+
+    // Intro section - wait for user confirmation
+    set_color(COLOR_YELLOW);
+    gfx_printf("Bereit zum Installieren/Aktualisieren.\n");
+    set_color(COLOR_WHITE);
+    gfx_printf("\n");
+    set_color(COLOR_GREEN);
+    gfx_printf("Druecke A-Taste (rechter Joy-Con) oder Power-Taste,\n");
+    gfx_printf("um die Installation zu starten...\n");
+    set_color(COLOR_WHITE);
+
+    wait_for_confirm();
+
+    // Clear the prompt and start installation
+    print_header();
+
+    // Perform the installation
+    set_color(COLOR_YELLOW);
+    gfx_printf("Installation wird gestartet...\n\n");
+    set_color(COLOR_WHITE);
+
+    // Checksums run on the A57 while the BPMP drives the SD card
+    worker_start();
+#ifdef PROFILE
+    profile_start();
+#endif
+    int result = perform_installation(pack_variant, mode);
+#ifdef PROFILE
+    profile_stop();
+#endif
+    worker_stop();
+
+    // Remember how the card behaved for the next boot
+    sd_tuning_save();
+    sd_cache_flush();
+
+    // Clear screen for final summary to ensure it's visible
+    print_header();
+
+    if (result == FR_OK && total_errors == 0) {
+        set_color(COLOR_GREEN);
+        gfx_printf("========================================\n");
+        gfx_printf("    Installation abgeschlossen!\n");
+        gfx_printf("========================================\n");
+    } else {
+        set_color(COLOR_RED);
+        gfx_printf("========================================\n");
+        gfx_printf("    Installation beendet\n");
+        if (total_errors > 0) {
+            gfx_printf("    %d Fehler\n", total_errors);
+        }
+        gfx_printf("========================================\n");
+    }
+    set_color(COLOR_WHITE);
+
+    // Where the time went, for bug reports
+    install_show_stats();
+
+    // Wait for user input before launching payload
+    gfx_printf("\n");
+    set_color(COLOR_GREEN);
+    gfx_printf("Druecke A-Taste (rechter Joy-Con) oder Power-Taste,\n");
+    gfx_printf("um Hekate zu starten...\n");
+    set_color(COLOR_WHITE);
+
+    wait_for_confirm();
+
+    gfx_printf("\n");
+    set_color(COLOR_CYAN);
+    gfx_printf("Payload wird gestartet...\n");
+    set_color(COLOR_WHITE);
+    msleep(500); // Brief delay before launch
+
+    if (file_exists(PAYLOAD_PATH))
+        return ENGINE_LAUNCH;
+
+    // Payload not found, show error
+    set_color(COLOR_RED);
+    gfx_printf("\nFEHLER: Payload nicht gefunden!\n");
+    gfx_printf("Pfad: %s\n", PAYLOAD_PATH);
+    set_color(COLOR_WHITE);
+    gfx_printf("\nDruecke A oder Power zum Neustart...\n");
+
+    wait_for_confirm();
+
+    return ENGINE_REBOOT;
+}
+
+// Where the reset vector of the BDK's exception handlers ends up (they are only
+// linked in for the profiler). The engine can't restart in place, reboot.
+void ipl_main(void) {
+    power_set_state(POWER_OFF_REBOOT);
+}
+
+void _modInit(void *config, bdkParams_t bdk) {
+    engine_cfg_t *cfg = config;
+
+    // An engine from another release may not match the stub
+    if (cfg->magic != ENGINE_MAGIC || strcmp(cfg->version, VERSION))
+        return;
+
+    // Continue on the stub's console, allocate from its heap
+    memcpy(&gfx_ctxt, bdk->gfxCtx, sizeof(gfx_ctxt_t));
+    memcpy(&gfx_con, bdk->gfxCon, sizeof(gfx_con_t));
+    gfx_con.gfx_ctxt = &gfx_ctxt;
+    heap_copy(bdk->sharedHeap);
+
+    cfg->sd_end();
+    cfg->result = engine_run();
+    sd_end();
+
+    memcpy(bdk->gfxCon, &gfx_con, sizeof(gfx_con_t));
+    ((gfx_con_t *)bdk->gfxCon)->gfx_ctxt = bdk->gfxCtx;
+    memcpy(bdk->sharedHeap, &_heap, sizeof(heap_t));
+}
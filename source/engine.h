@@ -0,0 +1,34 @@
+/*
+ * OmniNX Installer - Engine interface
+ *
+ * The payload is split in two. The stub (main.c) is what hekate loads into
+ * IRAM: hardware, DRAM and display bring-up, then loading the engine and
+ * chainloading hekate at the end. The engine (engine.c and the rest of the
+ * install code) is an ELF that the stub loads from the SD card into DRAM with
+ * ianos_loader() and calls once. It is built at -O2 in ARM mode and carries
+ * its own copy of the BDK, so the IRAM size limit doesn't apply to it.
+ */
+
+#pragma once
+#include <utils/types.h>
+
+#define ENGINE_PATH  "sd:/bootloader/sys/omninx_engine.bso"
+#define ENGINE_MAGIC 0x454E4E4F // "ONNE"
+
+// Chainloaded after the install
+#define PAYLOAD_PATH "sd:/bootloader/update.bin"
+
+typedef enum {
+    ENGINE_NOT_RUN, // Missing, unreadable or from another release
+    ENGINE_LAUNCH,  // Chainload PAYLOAD_PATH
+    ENGINE_REBOOT
+} engine_result_t;
+
+// Passed to the engine as its ianos module config. The stub fills in all but
+// result. The engine runs only if magic and version match its own.
+typedef struct {
+    u32 magic;
+    const char *version;  // VERSION of the stub
+    void (*sd_end)(void); // Lets the stub's SD driver release the card
+    u32 result;           // engine_result_t
+} engine_cfg_t;
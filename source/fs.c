@@ -3,19 +3,26 @@
  */
 
 #include "fs.h"
+#include "inventory.h"
+#include "progress.h"
+#include "sd_profile.h"
+#include "verify.h"
+#include "worker.h"
 #include <libs/fatfs/ff.h>
 #include <mem/heap.h>
 #include <string.h>
 #include <utils/sprintf.h>
+#include <utils/util.h>
 #include <stdarg.h>
 #include <stdio.h>
 
-#define FS_BUFFER_SIZE 0x100000  // 1MB copy buffer
+#define FS_BUFFER_SIZE 0x100000  // 1MB fallback copy buffer
 #define LOG_BUFFER_SIZE 512
 
 // Log file handle
 static FIL log_file;
 static bool log_enabled = false;
+static u32 log_lines = 0;
 static char log_buf[LOG_BUFFER_SIZE];
 
 // Initialize log file
@@ -51,7 +58,12 @@ void log_write(const char *fmt, ...) {
     // Write to file
     UINT bw;
     f_write(&log_file, log_buf, strlen(log_buf), &bw);
-    f_sync(&log_file);  // Flush to ensure data is written
+
+    // Flush to ensure data is written (less often on cards slow at small writes)
+    if (++log_lines >= sd_profile_get()->log_sync_lines) {
+        f_sync(&log_file);
+        log_lines = 0;
+    }
 }
 
 // Convert FatFS error code to string
@@ -98,6 +110,58 @@ static char *combine_paths(const char *base, const char *add) {
     return result;
 }
 
+// Count total items (files + directories) in a directory tree recursively.
+// bytes and files, if set, receive the total file size and file count.
+int count_directory_items(const char *path, u64 *bytes, u32 *files) {
+    DIR dir;
+    FILINFO fno;
+    int res;
+    int count = 0;
+
+    res = f_opendir(&dir, path);
+    if (res != FR_OK) {
+        return 0;
+    }
+
+    while (1) {
+        res = f_readdir(&dir, &fno);
+        if (res != FR_OK || fno.fname[0] == 0) break;
+
+        // Skip . and ..
+        if (fno.fname[0] == '.' && (fno.fname[1] == '\0' || (fno.fname[1] == '.' && fno.fname[2] == '\0'))) {
+            continue;
+        }
+
+        count++;
+
+        if (fno.fattrib & AM_DIR) {
+            char sub_path[256];
+            s_printf(sub_path, "%s/%s", path, fno.fname);
+            count += count_directory_items(sub_path, bytes, files);
+        } else {
+            if (bytes) *bytes += fno.fsize;
+            if (files) (*files)++;
+        }
+    }
+
+    f_closedir(&dir);
+    return count;
+}
+
+// Add the size and file count of a file or directory tree, if it exists
+void path_size(const char *path, u64 *bytes, u32 *files) {
+    FILINFO fno;
+
+    if (f_stat(path, &fno) != FR_OK) return;
+
+    if (fno.fattrib & AM_DIR) {
+        count_directory_items(path, bytes, files);
+    } else {
+        *bytes += fno.fsize;
+        (*files)++;
+    }
+}
+
 // Copy a single file with logging
 int file_copy(const char *src, const char *dst) {
     FIL fin, fout;
@@ -116,6 +180,13 @@ int file_copy(const char *src, const char *dst) {
     u64 file_size = f_size(&fin);
     log_write("  Size: %d bytes\n", (u32)file_size);
 
+    // Delta update: same content was installed here before
+    if (inventory_unchanged(src, dst, (u32)file_size)) {
+        f_close(&fin);
+        progress_add(file_size, 1);
+        return FR_OK;
+    }
+
     res = f_open(&fout, dst, FA_WRITE | FA_CREATE_ALWAYS);
     if (res != FR_OK) {
         f_close(&fin);
@@ -123,7 +194,13 @@ int file_copy(const char *src, const char *dst) {
         return res;
     }
 
-    u8 *buf = malloc(FS_BUFFER_SIZE);
+    // Transfer size depends on the card, fall back to 1MB if the heap is tight
+    u32 buf_size = sd_profile_get()->copy_buf_size;
+    u8 *buf = malloc(buf_size);
+    if (!buf && buf_size > FS_BUFFER_SIZE) {
+        buf_size = FS_BUFFER_SIZE;
+        buf = malloc(buf_size);
+    }
     if (!buf) {
         f_close(&fin);
         f_close(&fout);
@@ -131,11 +208,19 @@ int file_copy(const char *src, const char *dst) {
         return FR_NOT_ENOUGH_CORE;
     }
 
+    // Reserve one contiguous run for the whole file (NoFatChain on exFAT).
+    // If there is none, the file just grows cluster by cluster as before.
+    bool expanded = file_size && f_expand(&fout, file_size, 1) == FR_OK;
+
     u64 remaining = file_size;
+    u32 crc = 0;
     UINT br, bw;
+    verify_sha_t sha;
+
+    verify_begin(&sha, file_size);
 
     while (remaining > 0) {
-        UINT to_copy = (remaining > FS_BUFFER_SIZE) ? FS_BUFFER_SIZE : (UINT)remaining;
+        UINT to_copy = (remaining > buf_size) ? buf_size : (UINT)remaining;
 
         res = f_read(&fin, buf, to_copy, &br);
         if (res != FR_OK) {
@@ -147,8 +232,12 @@ int file_copy(const char *src, const char *dst) {
             res = FR_DISK_ERR;
             break;
         }
-
+        // The A57 checksums and the SE hashes the buffer while it is written out
+        worker_crc32_begin(crc, buf, to_copy);
+        verify_update(&sha, buf, to_copy);
         res = f_write(&fout, buf, to_copy, &bw);
+        verify_wait(&sha);
+        crc = worker_crc32_end();
         if (res != FR_OK) {
             log_write("  ERROR write: %s\n", fs_error_str(res));
             break;
@@ -160,14 +249,27 @@ int file_copy(const char *src, const char *dst) {
         }
 
         remaining -= to_copy;
+        progress_add(to_copy, 0);
+    }
+
+    // Don't leave preallocated garbage behind a failed copy
+    if (res != FR_OK && expanded) {
+        f_lseek(&fout, file_size - remaining);
+        f_truncate(&fout);
     }
 
     free(buf);
     f_close(&fin);
+    if (res == FR_OK)
+        inventory_add(dst, (u32)file_size, crc, fout.obj.sclust);
     f_close(&fout);
 
+    if (res == FR_OK)
+        res = verify_end(&sha, dst);
+
     if (res == FR_OK) {
         f_chmod(dst, fno.fattrib, 0x3A);
+        progress_add(0, 1);
         log_write("  OK\n");
     }
 
@@ -221,6 +323,8 @@ int folder_delete(const char *path) {
             res = f_unlink(full_path);
             if (res != FR_OK) {
                 log_write("    ERROR: %s\n", fs_error_str(res));
+            } else {
+                progress_add(fno.fsize, 1);
             }
         }
 
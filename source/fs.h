@@ -13,6 +13,12 @@ int file_copy(const char *src, const char *dst);
 int folder_copy(const char *src, const char *dst);
 int folder_delete(const char *path);
 
+// Sizes for the progress line. count_directory_items() returns the number of
+// items (directories included) below path, bytes and files are added to if set.
+// path_size() does the same for a file or a directory tree, if path exists.
+int count_directory_items(const char *path, u64 *bytes, u32 *files);
+void path_size(const char *path, u64 *bytes, u32 *files);
+
 // File logging
 void log_init(const char *path);
 void log_close(void);
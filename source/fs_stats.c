@@ -0,0 +1,280 @@
+/*
+ * OmniNX Installer - Filesystem call statistics
+ *
+ * "The update took 9 minutes" doesn't say whether the card was slow to write,
+ * to open files or to delete them. The FatFs calls the installer uses and the
+ * sector reads/writes under them are wrapped at link time (--wrap in the
+ * Makefile), so every caller is covered, including the BDK. Each call is
+ * timed with the microsecond timer and counted per install phase, with a log2
+ * histogram of its latency. The summary screen gets a compact table, the log
+ * all phases with their histograms.
+ */
+
+#include "fs_stats.h"
+#include "fs.h"
+#include "gfx.h"
+#include <libs/fatfs/diskio.h>
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
+#include <string.h>
+#include <utils/sprintf.h>
+#include <utils/util.h>
+
+#undef COLOR_CYAN
+#undef COLOR_WHITE
+#define COLOR_CYAN    0xFF00FFFF
+#define COLOR_WHITE   0xFFFFFFFF
+
+typedef struct {
+    u32 count;
+    u32 max_us;
+    u64 total_us;
+    u32 hist[FS_STATS_BUCKETS];
+} fs_op_stats_t;
+
+typedef struct {
+    const char *name;
+    u32 start_ms;
+    u32 ms;
+    fs_op_stats_t ops[FS_OP_COUNT];
+} fs_phase_stats_t;
+
+// Padded for the table, gfx_printf has no field width for strings
+static const char *const op_names[FS_OP_COUNT] = {
+    "f_open    ", "f_read    ", "f_write   ", "f_close   ", "f_stat    ", "f_unlink  ",
+    "f_mkdir   ", "f_readdir ", "f_rename  ", "disk_read ", "disk_write"
+};
+
+static fs_phase_stats_t *phases;
+static u32 phase_count;
+static bool counting;
+
+static void set_color(u32 color) {
+    gfx_con_setcol(color, gfx_con.fillbg, gfx_con.bgcol);
+}
+
+static u32 bucket_of(u32 us) {
+    u32 b = us ? 32 - __builtin_clz(us) : 0;
+    return MIN(b, FS_STATS_BUCKETS - 1);
+}
+
+// Upper bound of the bucket that holds the given share (in percent) of the calls.
+// Bucket b holds 2^(b-1) to 2^b - 1 us, the last one everything above.
+static u32 percentile_us(const fs_op_stats_t *op, u32 pct) {
+    u32 want = (op->count * pct + 99) / 100;
+    u32 seen = 0;
+
+    for (u32 b = 0; b < FS_STATS_BUCKETS; b++) {
+        seen += op->hist[b];
+        if (seen >= want)
+            return b == FS_STATS_BUCKETS - 1 ? op->max_us : MIN((1u << b) - 1, op->max_us);
+    }
+
+    return op->max_us;
+}
+
+static void fs_stats_add(u32 op, u32 start) {
+    if (!counting)
+        return;
+
+    u32 us = get_tmr_us() - start;
+    fs_op_stats_t *s = &phases[phase_count - 1].ops[op];
+    s->count++;
+    s->total_us += us;
+    s->max_us = MAX(s->max_us, us);
+    s->hist[bucket_of(us)]++;
+}
+
+void fs_stats_begin(void) {
+    fs_stats_free();
+    phases = calloc(FS_STATS_PHASES, sizeof(fs_phase_stats_t));
+}
+
+void fs_stats_phase(const char *name) {
+    if (!phases)
+        return;
+
+    u32 now = get_tmr_ms();
+    if (phase_count) {
+        fs_phase_stats_t *last = &phases[phase_count - 1];
+        last->ms += now - last->start_ms;
+    }
+
+    // More phases than fit are added to the last one
+    if (phase_count < FS_STATS_PHASES) {
+        phase_count++;
+        phases[phase_count - 1].name = name;
+    }
+    phases[phase_count - 1].start_ms = now;
+    counting = true;
+}
+
+static void fs_stats_log_op(const char *name, const fs_op_stats_t *op) {
+    char hist[FS_STATS_BUCKETS * 12 + 1];
+    u32 pos = 0;
+
+    for (u32 b = 0; b < FS_STATS_BUCKETS; b++) {
+        if (op->hist[b])
+            pos += s_printf(hist + pos, " %d:%d", b, op->hist[b]);
+    }
+    hist[pos] = 0;
+
+    log_write("  %s %7d %8d ms avg %6d us max %7d us |%s\n", name, op->count,
+        (u32)(op->total_us / 1000), (u32)(op->total_us / op->count), op->max_us, hist);
+}
+
+void fs_stats_end(void) {
+    if (!phases || !counting)
+        return;
+
+    counting = false;
+    fs_phase_stats_t *last = &phases[phase_count - 1];
+    last->ms += get_tmr_ms() - last->start_ms;
+
+    log_write("FS STATS: calls, time in the call, latency histogram (log2 us bucket:calls)\n");
+    for (u32 i = 0; i < phase_count; i++) {
+        log_write(" %s (%d ms)\n", phases[i].name, phases[i].ms);
+        for (u32 op = 0; op < FS_OP_COUNT; op++) {
+            if (phases[i].ops[op].count)
+                fs_stats_log_op(op_names[op], &phases[i].ops[op]);
+        }
+    }
+}
+
+void fs_stats_print(void) {
+    fs_op_stats_t *sum;
+
+    if (!phases)
+        return;
+
+    sum = calloc(FS_OP_COUNT, sizeof(fs_op_stats_t));
+    if (!sum)
+        return;
+
+    set_color(COLOR_CYAN);
+    gfx_printf("\nPhasen:");
+    for (u32 i = 0; i < phase_count; i++)
+        gfx_printf(" %s %d.%ds", phases[i].name, phases[i].ms / 1000, (phases[i].ms % 1000) / 100);
+    gfx_printf("\n");
+
+    for (u32 i = 0; i < phase_count; i++) {
+        for (u32 op = 0; op < FS_OP_COUNT; op++) {
+            fs_op_stats_t *s = &phases[i].ops[op];
+            sum[op].count += s->count;
+            sum[op].total_us += s->total_us;
+            sum[op].max_us = MAX(sum[op].max_us, s->max_us);
+            for (u32 b = 0; b < FS_STATS_BUCKETS; b++)
+                sum[op].hist[b] += s->hist[b];
+        }
+    }
+
+    gfx_printf("Aufruf       Anzahl  Zeit ms   p50 us   p99 us   max us\n");
+    set_color(COLOR_WHITE);
+    for (u32 op = 0; op < FS_OP_COUNT; op++) {
+        if (!sum[op].count)
+            continue;
+        gfx_printf("%s %8d %8d %8d %8d %8d\n", op_names[op], sum[op].count,
+            (u32)(sum[op].total_us / 1000), percentile_us(&sum[op], 50),
+            percentile_us(&sum[op], 99), sum[op].max_us);
+    }
+
+    free(sum);
+}
+
+void fs_stats_free(void) {
+    counting = false;
+    free(phases);
+    phases = NULL;
+    phase_count = 0;
+}
+
+// Link time wrappers, see FS_WRAP in the Makefile
+
+FRESULT __real_f_open(FIL *fp, const TCHAR *path, BYTE mode);
+FRESULT __real_f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT __real_f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT __real_f_close(FIL *fp);
+FRESULT __real_f_stat(const TCHAR *path, FILINFO *fno);
+FRESULT __real_f_unlink(const TCHAR *path);
+FRESULT __real_f_mkdir(const TCHAR *path);
+FRESULT __real_f_readdir(DIR *dp, FILINFO *fno);
+FRESULT __real_f_rename(const TCHAR *path_old, const TCHAR *path_new);
+DRESULT __real_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+DRESULT __real_disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
+FRESULT __wrap_f_open(FIL *fp, const TCHAR *path, BYTE mode) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_open(fp, path, mode);
+    fs_stats_add(FS_OP_OPEN, t);
+    return res;
+}
+
+FRESULT __wrap_f_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_read(fp, buff, btr, br);
+    fs_stats_add(FS_OP_READ, t);
+    return res;
+}
+
+FRESULT __wrap_f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_write(fp, buff, btw, bw);
+    fs_stats_add(FS_OP_WRITE, t);
+    return res;
+}
+
+FRESULT __wrap_f_close(FIL *fp) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_close(fp);
+    fs_stats_add(FS_OP_CLOSE, t);
+    return res;
+}
+
+FRESULT __wrap_f_stat(const TCHAR *path, FILINFO *fno) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_stat(path, fno);
+    fs_stats_add(FS_OP_STAT, t);
+    return res;
+}
+
+FRESULT __wrap_f_unlink(const TCHAR *path) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_unlink(path);
+    fs_stats_add(FS_OP_UNLINK, t);
+    return res;
+}
+
+FRESULT __wrap_f_mkdir(const TCHAR *path) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_mkdir(path);
+    fs_stats_add(FS_OP_MKDIR, t);
+    return res;
+}
+
+FRESULT __wrap_f_readdir(DIR *dp, FILINFO *fno) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_readdir(dp, fno);
+    fs_stats_add(FS_OP_READDIR, t);
+    return res;
+}
+
+FRESULT __wrap_f_rename(const TCHAR *path_old, const TCHAR *path_new) {
+    u32 t = get_tmr_us();
+    FRESULT res = __real_f_rename(path_old, path_new);
+    fs_stats_add(FS_OP_RENAME, t);
+    return res;
+}
+
+DRESULT __wrap_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
+    u32 t = get_tmr_us();
+    DRESULT res = __real_disk_read(pdrv, buff, sector, count);
+    fs_stats_add(FS_OP_DISK_READ, t);
+    return res;
+}
+
+DRESULT __wrap_disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) {
+    u32 t = get_tmr_us();
+    DRESULT res = __real_disk_write(pdrv, buff, sector, count);
+    fs_stats_add(FS_OP_DISK_WRITE, t);
+    return res;
+}
@@ -0,0 +1,39 @@
+/*
+ * OmniNX Installer - Filesystem call statistics
+ */
+
+#pragma once
+#include <utils/types.h>
+
+#define FS_STATS_PHASES  8
+#define FS_STATS_BUCKETS 24 // log2 of the latency in us, the last one is open
+
+enum {
+    FS_OP_OPEN,
+    FS_OP_READ,
+    FS_OP_WRITE,
+    FS_OP_CLOSE,
+    FS_OP_STAT,
+    FS_OP_UNLINK,
+    FS_OP_MKDIR,
+    FS_OP_READDIR,
+    FS_OP_RENAME,
+    FS_OP_DISK_READ,
+    FS_OP_DISK_WRITE,
+    FS_OP_COUNT
+};
+
+// Start counting. Calls made before this or after fs_stats_end() are not counted.
+void fs_stats_begin(void);
+
+// Count the following calls under a new phase (e.g. one install step)
+void fs_stats_phase(const char *name);
+
+// Close the last phase, append the full tables to the log and stop counting
+void fs_stats_end(void);
+
+// Compact table of all phases for the summary screen
+void fs_stats_print(void);
+
+// Free the tables
+void fs_stats_free(void);
@@ -0,0 +1,445 @@
+/*
+ * OmniNX Installer - Streaming DEFLATE decoder
+ *
+ * Decodes raw DEFLATE (RFC 1951) as stored in ZIP entries, pulling compressed
+ * data through a read callback and pushing output through a write callback,
+ * so an entry of any size goes from the archive to its destination file with
+ * fixed memory. The output buffer doubles as the 32KB history window; it is
+ * flushed once it is nearly full, which keeps writes large.
+ *
+ * Huffman codes are decoded through a 9-bit lookup table, longer codes fall
+ * back to the canonical bit-by-bit walk.
+ */
+
+#include "inflate.h"
+#include <mem/heap.h>
+#include <string.h>
+#include <utils/util.h>
+
+#define INFLATE_MAX_BITS  15
+#define INFLATE_FAST_BITS 9
+#define INFLATE_MAX_MATCH 258
+#define INFLATE_WINDOW    0x8000
+
+typedef struct {
+    u16 count[INFLATE_MAX_BITS + 1];
+    u16 symbol[288];
+    u16 fast[1 << INFLATE_FAST_BITS]; // symbol << 4 | length, 0 for codes longer than FAST_BITS
+} huff_t;
+
+static const u16 len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const u8 dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const u8 clen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Tables are large for the stack, one decode runs at a time
+static huff_t lit_code;
+static huff_t dist_code;
+
+int inflate_init(inflate_t *s, u32 in_size, u32 out_size) {
+    memset(s, 0, sizeof(*s));
+
+    if (out_size < 2 * INFLATE_WINDOW || (out_size & (out_size - 1)))
+        return INFLATE_ERR_MEM;
+
+    s->in = malloc(in_size);
+    s->out = malloc(out_size);
+    if (!s->in || !s->out) {
+        inflate_end(s);
+        return INFLATE_ERR_MEM;
+    }
+
+    s->in_size = in_size;
+    s->out_mask = out_size - 1;
+
+    return INFLATE_OK;
+}
+
+void inflate_end(inflate_t *s) {
+    free(s->in);
+    free(s->out);
+    s->in = NULL;
+    s->out = NULL;
+}
+
+static void inflate_refill(inflate_t *s) {
+    u32 read = 0;
+
+    if (s->in_eof)
+        return;
+
+    if (s->read(s->ctx, s->in, s->in_size, &read) != 0) {
+        s->err = INFLATE_ERR_IO;
+        read = 0;
+    }
+
+    s->in_pos = 0;
+    s->in_len = read;
+    if (!read)
+        s->in_eof = true;
+}
+
+// Top up the bit buffer to at least 25 bits while input is left
+static void inflate_fill(inflate_t *s) {
+    while (s->bitcnt <= 24) {
+        if (s->in_pos == s->in_len) {
+            inflate_refill(s);
+            if (s->in_pos == s->in_len)
+                return;
+        }
+        s->bitbuf |= (u32)s->in[s->in_pos++] << s->bitcnt;
+        s->bitcnt += 8;
+    }
+}
+
+static u32 inflate_bits(inflate_t *s, u32 n) {
+    if (s->bitcnt < n) {
+        inflate_fill(s);
+        if (s->bitcnt < n) {
+            if (!s->err)
+                s->err = INFLATE_ERR_IO;
+            return 0;
+        }
+    }
+
+    u32 val = s->bitbuf & ((1u << n) - 1);
+    s->bitbuf >>= n;
+    s->bitcnt -= n;
+
+    return val;
+}
+
+static int inflate_build(huff_t *h, const u8 *lens, u32 n) {
+    u16 offs[INFLATE_MAX_BITS + 1];
+    u16 next[INFLATE_MAX_BITS + 1];
+
+    memset(h->count, 0, sizeof(h->count));
+    memset(h->fast, 0, sizeof(h->fast));
+    for (u32 i = 0; i < n; i++)
+        h->count[lens[i]]++;
+    h->count[0] = 0;
+
+    // Reject over-subscribed codes, incomplete ones are allowed (single distance code)
+    int left = 1;
+    for (u32 len = 1; len <= INFLATE_MAX_BITS; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0)
+            return INFLATE_ERR_DATA;
+    }
+
+    offs[1] = 0;
+    next[1] = 0;
+    for (u32 len = 1; len < INFLATE_MAX_BITS; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+        next[len + 1] = (next[len] + h->count[len]) << 1;
+    }
+
+    for (u32 sym = 0; sym < n; sym++) {
+        u32 len = lens[sym];
+        if (!len)
+            continue;
+
+        h->symbol[offs[len]++] = sym;
+
+        u32 code = next[len]++;
+        if (len > INFLATE_FAST_BITS)
+            continue;
+
+        // Codes are stored MSB first in the stream, the table is indexed LSB first
+        u32 rev = 0;
+        for (u32 i = 0; i < len; i++)
+            rev |= ((code >> i) & 1) << (len - 1 - i);
+        for (u32 fill = rev; fill < (1u << INFLATE_FAST_BITS); fill += 1u << len)
+            h->fast[fill] = sym << 4 | len;
+    }
+
+    return INFLATE_OK;
+}
+
+static u32 inflate_decode(inflate_t *s, const huff_t *h) {
+    if (s->bitcnt < INFLATE_MAX_BITS)
+        inflate_fill(s);
+
+    u32 e = h->fast[s->bitbuf & ((1 << INFLATE_FAST_BITS) - 1)];
+    if (e && (e & 0xF) <= s->bitcnt) {
+        s->bitbuf >>= e & 0xF;
+        s->bitcnt -= e & 0xF;
+        return e >> 4;
+    }
+
+    // Canonical decode, one bit at a time
+    int code = 0, first = 0, index = 0;
+    for (u32 len = 1; len <= INFLATE_MAX_BITS; len++) {
+        code |= inflate_bits(s, 1);
+        if (s->err)
+            return 0;
+        int count = h->count[len];
+        if (code - count < first)
+            return h->symbol[index + (code - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+
+    s->err = INFLATE_ERR_DATA;
+    return 0;
+}
+
+static void inflate_flush(inflate_t *s) {
+    while (s->flushed != s->pos && !s->err) {
+        u32 start = s->flushed & s->out_mask;
+        u32 size = s->pos - s->flushed;
+        if (start + size > s->out_mask + 1)
+            size = s->out_mask + 1 - start;
+
+        s->crc = crc32_calc(s->crc, s->out + start, size);
+        if (s->write(s->ctx, s->out + start, size) != 0)
+            s->err = INFLATE_ERR_IO;
+        s->flushed += size;
+    }
+}
+
+// Make room for one literal or match without overwriting unflushed output
+static inline void inflate_reserve(inflate_t *s) {
+    if (s->pos - s->flushed > s->out_mask - INFLATE_MAX_MATCH)
+        inflate_flush(s);
+}
+
+static void inflate_stored(inflate_t *s) {
+    // Drop the rest of the current byte, then LEN and NLEN
+    inflate_bits(s, s->bitcnt & 7);
+    u32 len = inflate_bits(s, 16);
+    u32 nlen = inflate_bits(s, 16);
+    if (s->err)
+        return;
+    if (len != (~nlen & 0xFFFF)) {
+        s->err = INFLATE_ERR_DATA;
+        return;
+    }
+
+    while (len && !s->err) {
+        inflate_reserve(s);
+
+        // Whole bytes may still sit in the bit buffer
+        if (s->bitcnt) {
+            s->out[s->pos++ & s->out_mask] = inflate_bits(s, 8);
+            len--;
+            continue;
+        }
+
+        if (s->in_pos == s->in_len) {
+            inflate_refill(s);
+            if (s->in_pos == s->in_len) {
+                if (!s->err)
+                    s->err = INFLATE_ERR_IO;
+                return;
+            }
+        }
+
+        u32 chunk = MIN(len, s->in_len - s->in_pos);
+        u32 start = s->pos & s->out_mask;
+        chunk = MIN(chunk, s->out_mask + 1 - start);
+        chunk = MIN(chunk, s->out_mask + 1 - (s->pos - s->flushed));
+        memcpy(s->out + start, s->in + s->in_pos, chunk);
+        s->in_pos += chunk;
+        s->pos += chunk;
+        len -= chunk;
+    }
+}
+
+static void inflate_codes(inflate_t *s, const huff_t *lcode, const huff_t *dcode) {
+    while (!s->err) {
+        inflate_reserve(s);
+
+        u32 sym = inflate_decode(s, lcode);
+        if (s->err)
+            return;
+
+        if (sym < 256) {
+            s->out[s->pos++ & s->out_mask] = sym;
+            continue;
+        }
+        if (sym == 256)
+            return;
+
+        sym -= 257;
+        if (sym >= 29) {
+            s->err = INFLATE_ERR_DATA;
+            return;
+        }
+        u32 len = len_base[sym] + inflate_bits(s, len_extra[sym]);
+
+        sym = inflate_decode(s, dcode);
+        if (s->err)
+            return;
+        if (sym >= 30) {
+            s->err = INFLATE_ERR_DATA;
+            return;
+        }
+        u32 dist = dist_base[sym] + inflate_bits(s, dist_extra[sym]);
+        if (s->err)
+            return;
+        if (dist > s->pos) {
+            s->err = INFLATE_ERR_DATA;
+            return;
+        }
+
+        u32 mask = s->out_mask;
+        u32 pos = s->pos;
+        while (len--) {
+            s->out[pos & mask] = s->out[(pos - dist) & mask];
+            pos++;
+        }
+        s->pos = pos;
+    }
+}
+
+static void inflate_fixed(inflate_t *s) {
+    static bool built = false;
+    static huff_t fixed_lit;
+    static huff_t fixed_dist;
+
+    if (!built) {
+        u8 lens[288];
+        u32 i;
+        for (i = 0; i < 144; i++) lens[i] = 8;
+        for (; i < 256; i++)      lens[i] = 9;
+        for (; i < 280; i++)      lens[i] = 7;
+        for (; i < 288; i++)      lens[i] = 8;
+        inflate_build(&fixed_lit, lens, 288);
+
+        for (i = 0; i < 30; i++)  lens[i] = 5;
+        inflate_build(&fixed_dist, lens, 30);
+        built = true;
+    }
+
+    inflate_codes(s, &fixed_lit, &fixed_dist);
+}
+
+static void inflate_dynamic(inflate_t *s) {
+    u8 lens[288 + 32];
+
+    u32 nlen = inflate_bits(s, 5) + 257;
+    u32 ndist = inflate_bits(s, 5) + 1;
+    u32 ncode = inflate_bits(s, 4) + 4;
+    if (s->err)
+        return;
+    if (nlen > 286 || ndist > 30) {
+        s->err = INFLATE_ERR_DATA;
+        return;
+    }
+
+    memset(lens, 0, 19);
+    for (u32 i = 0; i < ncode; i++)
+        lens[clen_order[i]] = inflate_bits(s, 3);
+    if (s->err || inflate_build(&lit_code, lens, 19) != INFLATE_OK) {
+        if (!s->err)
+            s->err = INFLATE_ERR_DATA;
+        return;
+    }
+
+    // Literal/length and distance code lengths share one run-length coded sequence
+    u32 i = 0;
+    while (i < nlen + ndist) {
+        u32 sym = inflate_decode(s, &lit_code);
+        if (s->err)
+            return;
+
+        if (sym < 16) {
+            lens[i++] = sym;
+            continue;
+        }
+
+        u32 len = 0, rep;
+        if (sym == 16) {
+            if (!i) {
+                s->err = INFLATE_ERR_DATA;
+                return;
+            }
+            len = lens[i - 1];
+            rep = 3 + inflate_bits(s, 2);
+        } else if (sym == 17) {
+            rep = 3 + inflate_bits(s, 3);
+        } else {
+            rep = 11 + inflate_bits(s, 7);
+        }
+        if (s->err)
+            return;
+        if (i + rep > nlen + ndist) {
+            s->err = INFLATE_ERR_DATA;
+            return;
+        }
+        while (rep--)
+            lens[i++] = len;
+    }
+
+    if (!lens[256] ||
+        inflate_build(&lit_code, lens, nlen) != INFLATE_OK ||
+        inflate_build(&dist_code, lens + nlen, ndist) != INFLATE_OK) {
+        s->err = INFLATE_ERR_DATA;
+        return;
+    }
+
+    inflate_codes(s, &lit_code, &dist_code);
+}
+
+int inflate_stream(inflate_t *s, inflate_read_t read, inflate_write_t write, void *ctx) {
+    u32 last;
+
+    s->read = read;
+    s->write = write;
+    s->ctx = ctx;
+    s->in_pos = 0;
+    s->in_len = 0;
+    s->in_eof = false;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    s->pos = 0;
+    s->flushed = 0;
+    s->crc = 0;
+    s->err = INFLATE_OK;
+
+    do {
+        last = inflate_bits(s, 1);
+        u32 type = inflate_bits(s, 2);
+        if (s->err)
+            break;
+
+        switch (type) {
+        case 0:
+            inflate_stored(s);
+            break;
+        case 1:
+            inflate_fixed(s);
+            break;
+        case 2:
+            inflate_dynamic(s);
+            break;
+        default:
+            s->err = INFLATE_ERR_DATA;
+            break;
+        }
+    } while (!last && !s->err);
+
+    if (!s->err)
+        inflate_flush(s);
+
+    return s->err;
+}
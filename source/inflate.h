@@ -0,0 +1,47 @@
+/*
+ * OmniNX Installer - Streaming DEFLATE decoder
+ */
+
+#pragma once
+#include <utils/types.h>
+
+#define INFLATE_OK        0
+#define INFLATE_ERR_DATA -1 // Corrupt stream
+#define INFLATE_ERR_IO   -2 // Read or write callback failed, or input ended early
+#define INFLATE_ERR_MEM  -3
+
+// Fill buf with up to size bytes of compressed input. *read = 0 means end of input.
+typedef int (*inflate_read_t)(void *ctx, u8 *buf, u32 size, u32 *read);
+// Consume size bytes of decompressed output. Non-zero aborts the stream.
+typedef int (*inflate_write_t)(void *ctx, const u8 *buf, u32 size);
+
+typedef struct {
+    u8  *in;
+    u32 in_size;
+    u32 in_pos;
+    u32 in_len;
+    bool in_eof;
+
+    u32 bitbuf;
+    u32 bitcnt;
+
+    u8  *out;       // Circular output buffer, also the 32KB history window
+    u32 out_mask;
+    u32 pos;        // Total bytes produced
+    u32 flushed;    // Total bytes passed to write()
+
+    u32 crc;        // CRC32 of the produced data
+    int err;
+
+    inflate_read_t  read;
+    inflate_write_t write;
+    void *ctx;
+} inflate_t;
+
+// Allocate the input and output buffers. out_size must be a power of two >= 64KB.
+int inflate_init(inflate_t *s, u32 in_size, u32 out_size);
+void inflate_end(inflate_t *s);
+
+// Decode one raw DEFLATE stream (no zlib/gzip header). The buffers are reused
+// between streams. s->pos and s->crc hold the size and CRC32 of the output.
+int inflate_stream(inflate_t *s, inflate_read_t read, inflate_write_t write, void *ctx);
@@ -4,13 +4,23 @@
 
 #include "install.h"
 #include "backup.h"
+#include "copy_plan.h"
 #include "deletion_lists.h"
 #include "fs.h"
+#include "fs_stats.h"
+#include "inventory.h"
+#include "progress.h"
+#include "verify.h"
 #include "version.h"
+#include "zip.h"
 #include "gfx.h"
+#include "nx_sd.h"
+#include <libs/fatfs/diskio.h>
 #include <libs/fatfs/ff.h>
+#include <mem/heap.h>
 #include <string.h>
 #include <utils/sprintf.h>
+#include <utils/util.h>
 
 #ifndef VERSION
 #define VERSION "1.0.0"
@@ -67,41 +77,6 @@ static bool path_exists(const char *path) {
     return (f_stat(path, &fno) == FR_OK);
 }
 
-// Count total items (files + directories) in a directory tree recursively
-static int count_directory_items(const char *path) {
-    DIR dir;
-    FILINFO fno;
-    int res;
-    int count = 0;
-    
-    res = f_opendir(&dir, path);
-    if (res != FR_OK) {
-        return 0;
-    }
-    
-    while (1) {
-        res = f_readdir(&dir, &fno);
-        if (res != FR_OK || fno.fname[0] == 0) break;
-        
-        // Skip . and ..
-        if (fno.fname[0] == '.' && (fno.fname[1] == '\0' || (fno.fname[1] == '.' && fno.fname[2] == '\0'))) {
-            continue;
-        }
-        
-        count++; // Count this item
-        
-        // If it's a directory, recursively count its contents
-        if (fno.fattrib & AM_DIR) {
-            char sub_path[256];
-            s_printf(sub_path, "%s/%s", path, fno.fname);
-            count += count_directory_items(sub_path);
-        }
-    }
-    
-    f_closedir(&dir);
-    return count;
-}
-
 // Helper to combine paths (handles trailing slashes properly)
 static void combine_path(char *result, size_t size, const char *base, const char *add) {
     size_t base_len = strlen(base);
@@ -114,8 +89,8 @@ static void combine_path(char *result, size_t size, const char *base, const char
     }
 }
 
-// Recursive folder copy with progress tracking
-static int folder_copy_progress_recursive(const char *src, const char *dst, int *copied, int total, u32 start_x, u32 start_y, const char *display_name, int *last_percent) {
+// Recursive folder copy, file_copy() reports every file to the progress line
+static int folder_copy_progress_recursive(const char *src, const char *dst) {
     DIR dir;
     FILINFO fno;
     int res;
@@ -175,24 +150,9 @@ static int folder_copy_progress_recursive(const char *src, const char *dst, int
         combine_path(dst_full, sizeof(dst_full), dst_dir, fno.fname);
         
         if (fno.fattrib & AM_DIR) {
-            res = folder_copy_progress_recursive(src_full, dst_dir, copied, total, start_x, start_y, display_name, last_percent);
-            // Increment counter for directory (it was counted in total)
-            (*copied)++;
+            res = folder_copy_progress_recursive(src_full, dst_dir);
         } else {
             res = file_copy(src_full, dst_full);
-            (*copied)++;
-        }
-        
-        // Update progress every 10 items or when percentage changes
-        if ((*copied % 10 == 0 || total == 0) && res == FR_OK) {
-            int percent = total > 0 ? (*copied * 100) / total : 0;
-            if (percent != *last_percent || *copied % 50 == 0) {
-                gfx_con_setpos(start_x, start_y);
-                set_color(COLOR_CYAN);
-                gfx_printf("  Kopiere: %s [%3d%%] (%d/%d)", display_name, percent, *copied, total);
-                set_color(COLOR_WHITE);
-                *last_percent = percent;
-            }
         }
         
         if (res != FR_OK) break;
@@ -204,10 +164,8 @@ static int folder_copy_progress_recursive(const char *src, const char *dst, int
 
 // Progress-aware folder copy (improved version)
 static int folder_copy_with_progress_v2(const char *src, const char *dst, const char *display_name) {
-    int copied = 0;
     int total = 0;
-    int last_percent = -1;
-    u32 start_x, start_y;
+    copy_plan_t plan;
     int res;
     
     // Check if source exists
@@ -218,8 +176,10 @@ static int folder_copy_with_progress_v2(const char *src, const char *dst, const
         return FR_NO_FILE;
     }
     
-    // Count total items first
-    total = count_directory_items(src);
+    // Count total items and size first
+    u64 total_bytes = 0;
+    u32 files = 0;
+    total = count_directory_items(src, &total_bytes, &files);
     
     if (total == 0) {
         // Empty directory, just create destination
@@ -235,26 +195,26 @@ static int folder_copy_with_progress_v2(const char *src, const char *dst, const
         return res;
     }
     
-    // Save cursor position
-    gfx_con_getpos(&start_x, &start_y);
+    // Place the whole subtree in one free region, so it is written and later read sequentially.
+    // If no region is big enough, allocation just continues where it was.
+    f_alloc_hint("sd:", total_bytes, total + 1);
     
-    // Show initial status
-    set_color(COLOR_CYAN);
-    gfx_printf("  Kopiere: %s [  0%%] (0/%d)", display_name, total);
-    set_color(COLOR_WHITE);
+    progress_begin(PROGRESS_COPY, display_name, total_bytes, files);
     
-    // Perform the copy with progress updates
-    res = folder_copy_progress_recursive(src, dst, &copied, total, start_x, start_y, display_name, &last_percent);
+    // Copy the files sorted by their position on the card, so reading them is one forward sweep.
+    // If the file list does not fit in memory, copy in directory order instead.
+    res = copy_plan_build(&plan, src, dst, total);
+    if (res == FR_OK) {
+        res = copy_plan_run(&plan);
+        copy_plan_free(&plan);
+    } else if (res == FR_NOT_ENOUGH_CORE) {
+        res = folder_copy_progress_recursive(src, dst);
+    }
     
     // Final update - overwrite the same line
-    gfx_con_setpos(start_x, start_y);
-    if (res == FR_OK) {
-        set_color(COLOR_GREEN);
-        gfx_printf("  Kopiere: %s [100%%] (%d/%d) - Fertig!\n", display_name, copied, total);
-        set_color(COLOR_WHITE);
-    } else {
+    progress_end(res == FR_OK);
+    if (res != FR_OK) {
         set_color(COLOR_RED);
-        gfx_printf("  Kopiere: %s - Fehlgeschlagen!\n", display_name);
         gfx_printf("  Fehler: %s (Code=%d)\n", fs_error_str(res), res);
         gfx_printf("  Quelle: %s\n", src);
         gfx_printf("  Ziel: %s\n", dst);
@@ -291,6 +251,8 @@ int delete_path_list(const char* paths[], const char* description) {
                 res = folder_delete(paths[i]);
             } else {
                 res = f_unlink(paths[i]);
+                if (res == FR_OK)
+                    progress_add(fno.fsize, 1);
             }
             
             if (res == FR_OK || res == FR_NO_FILE) {
@@ -317,63 +279,183 @@ int cleanup_old_version_markers(omninx_variant_t current_variant) {
     return FR_OK;
 }
 
+// Path lists of the cleanup sections, one progress line each
+static const char **atmosphere_lists[] = {
+    atmosphere_dirs_to_delete,
+    atmosphere_root_dirs_to_delete,
+    atmosphere_contents_dirs_to_delete,
+    atmosphere_files_to_delete,
+    NULL
+};
+
+static const char **bootloader_lists[] = {
+    bootloader_dirs_to_delete,
+    bootloader_files_to_delete,
+    NULL
+};
+
+static const char **config_lists[] = {
+    config_dirs_to_delete,
+    NULL
+};
+
+static const char **switch_lists[] = {
+    switch_dirs_to_delete,
+    switch_files_to_delete,
+    NULL
+};
+
+static const char **root_lists[] = {
+    root_files_to_delete,
+    misc_dirs_to_delete,
+    misc_files_to_delete,
+    NULL
+};
+
+// Delete some path lists under one progress line, counting their files first
+static int delete_path_lists(const char *name, const char **lists[]) {
+    u64 bytes = 0;
+    u32 files = 0;
+    int res = FR_OK;
+    
+    for (int i = 0; lists[i] != NULL; i++) {
+        for (int j = 0; lists[i][j] != NULL; j++)
+            path_size(lists[i][j], &bytes, &files);
+    }
+    
+    progress_begin(PROGRESS_CLEANUP, name, bytes, files);
+    for (int i = 0; lists[i] != NULL; i++) {
+        if (delete_path_list(lists[i], name) != FR_OK)
+            res = FR_DISK_ERR;
+    }
+    progress_end(res == FR_OK);
+    
+    return res;
+}
+
 // Update mode: Cleanup specific directories/files
 int update_mode_cleanup(omninx_variant_t variant) {
     check_and_clear_screen_if_needed();
     
-    set_color(COLOR_CYAN);
-    gfx_printf("  Bereinige: atmosphere/\n");
-    set_color(COLOR_WHITE);
-    // Delete atmosphere subdirectories
-    delete_path_list(atmosphere_dirs_to_delete, "atmosphere subdirs");
+    delete_path_lists("atmosphere/", atmosphere_lists);
+    delete_path_lists("bootloader/", bootloader_lists);
+    delete_path_lists("config/", config_lists);
+    delete_path_lists("switch/", switch_lists);
+    delete_path_lists("Root-Dateien", root_lists);
     
-    // Delete atmosphere root directories (title IDs)
-    delete_path_list(atmosphere_root_dirs_to_delete, "atmosphere root dirs");
+    set_color(COLOR_GREEN);
+    gfx_printf("  Bereinigung abgeschlossen!\n");
+    set_color(COLOR_WHITE);
     
-    // Delete atmosphere contents directories (title IDs)
-    delete_path_list(atmosphere_contents_dirs_to_delete, "atmosphere contents dirs");
+    return FR_OK;
+}
+
+// Pack folders and root files that are installed from the staging folder or ZIP
+static const char *pack_dirs[] = {
+    "atmosphere",
+    "bootloader",
+    "config",
+    "switch",
+    "warmboot_mariko",
+    "SaltySD",
+    NULL
+};
+
+static const char *pack_root_files[] = {
+    "boot.dat",
+    "boot.ini",
+    "exosphere.ini",
+    "hbmenu.nro",
+    "loader.bin",
+    "payload.bin",
+    NULL
+};
+
+// OC variant includes SaltySD (this is the large one with ~2500 files)
+static bool pack_dir_wanted(const char *dir, omninx_variant_t variant) {
+    return strcmp(dir, "SaltySD") || variant == VARIANT_OC;
+}
+
+// ZIP entry filter: rel is the path below the pack folder
+static bool pack_entry_wanted(const char *rel, void *ctx) {
+    omninx_variant_t variant = *(omninx_variant_t *)ctx;
+    const char *slash = strchr(rel, '/');
+    
+    if (!slash) {
+        for (int i = 0; pack_root_files[i] != NULL; i++) {
+            if (!strcmp(rel, pack_root_files[i])) return true;
+        }
+        return false;
+    }
     
-    // Delete atmosphere files
-    delete_path_list(atmosphere_files_to_delete, "atmosphere files");
+    for (int i = 0; pack_dirs[i] != NULL; i++) {
+        u32 len = strlen(pack_dirs[i]);
+        if ((u32)(slash - rel) == len && !strncmp(rel, pack_dirs[i], len))
+            return pack_dir_wanted(pack_dirs[i], variant);
+    }
+    return false;
+}
+
+// Extract the pack straight from the release ZIP
+static int install_from_zip(const char *zip_path, omninx_variant_t variant) {
+    u32 total = 0;
+    u64 total_bytes = 0;
     
     set_color(COLOR_CYAN);
-    gfx_printf("  Bereinige: bootloader/\n");
+    gfx_printf("  Entpacke: %s\n", zip_path + 4);
     set_color(COLOR_WHITE);
-    // Delete bootloader directories
-    delete_path_list(bootloader_dirs_to_delete, "bootloader dirs");
     
-    // Delete bootloader files
-    delete_path_list(bootloader_files_to_delete, "bootloader files");
-    
-    set_color(COLOR_CYAN);
-    gfx_printf("  Bereinige: config/\n");
-    set_color(COLOR_WHITE);
-    // Delete config directories
-    delete_path_list(config_dirs_to_delete, "config dirs");
+    int res = zip_open(zip_path, variant, pack_entry_wanted, &variant, &total, &total_bytes);
+    if (res == FR_OK) {
+        // Hash list of the pack, checked while the files are written
+        u8 *list;
+        u32 list_size;
+        if (zip_read_entry(VERIFY_LIST_NAME, &list, &list_size) == FR_OK) {
+            verify_load_list((char *)list, list_size);
+            free(list);
+        }
+        
+        f_alloc_hint("sd:", total_bytes, total);
+        
+        progress_begin(PROGRESS_COPY, "ZIP", total_bytes, total);
+        res = zip_extract("sd:/");
+        progress_end(res == FR_OK);
+        zip_close();
+    }
     
-    set_color(COLOR_CYAN);
-    gfx_printf("  Bereinige: switch/\n");
-    set_color(COLOR_WHITE);
-    // Delete switch directories
-    delete_path_list(switch_dirs_to_delete, "switch dirs");
+    if (res != FR_OK) {
+        set_color(COLOR_RED);
+        gfx_printf("  Entpacken fehlgeschlagen!\n");
+        gfx_printf("  Fehler: %s (Code=%d)\n", fs_error_str(res), res);
+        set_color(COLOR_WHITE);
+    }
     
-    // Delete switch files
-    delete_path_list(switch_files_to_delete, "switch files");
+    return res;
+}
+
+// SHA-256 check of the copied files against the pack (see verify.c)
+static int show_verify_result(void) {
+    u32 ok, bad, unlisted;
     
-    set_color(COLOR_CYAN);
-    gfx_printf("  Bereinige: Root-Dateien\n");
-    set_color(COLOR_WHITE);
-    // Delete root files
-    delete_path_list(root_files_to_delete, "root files");
+    if (!verify_enabled()) return FR_OK;
     
-    // Delete miscellaneous directories
-    delete_path_list(misc_dirs_to_delete, "misc dirs");
+    verify_counts(&ok, &bad, &unlisted);
+    verify_free();
+    log_write("VERIFY: %d ok, %d bad, %d not listed\n", ok, bad, unlisted);
     
-    // Delete miscellaneous files
-    delete_path_list(misc_files_to_delete, "misc files");
+    if (bad) {
+        set_color(COLOR_RED);
+        gfx_printf("  [FEHLER] %d Dateien fehlerhaft (SHA-256), siehe Log\n", bad);
+        set_color(COLOR_WHITE);
+        return FR_INT_ERR;
+    }
     
     set_color(COLOR_GREEN);
-    gfx_printf("  Bereinigung abgeschlossen!\n");
+    gfx_printf("  [OK] SHA-256 geprueft: %d Dateien\n", ok);
+    if (unlisted) {
+        set_color(COLOR_ORANGE);
+        gfx_printf("  [WARN] %d Dateien nicht in %s\n", unlisted, VERIFY_LIST_NAME);
+    }
     set_color(COLOR_WHITE);
     
     return FR_OK;
@@ -396,74 +478,53 @@ int update_mode_install(omninx_variant_t variant) {
     gfx_printf("Dateien werden kopiert...\n");
     set_color(COLOR_WHITE);
     
-    // Copy directories (use progress-aware copy for large directories)
-    s_printf(src_path, "%s/atmosphere", staging);
-    res = folder_copy_with_progress_v2(src_path, "sd:/", "atmosphere/");
-    if (res != FR_OK && res != FR_NO_FILE) return res;
-    
-    s_printf(src_path, "%s/bootloader", staging);
-    res = folder_copy_with_progress_v2(src_path, "sd:/", "bootloader/");
-    if (res != FR_OK && res != FR_NO_FILE) return res;
-    
-    s_printf(src_path, "%s/config", staging);
-    res = folder_copy_with_progress_v2(src_path, "sd:/", "config/");
-    if (res != FR_OK && res != FR_NO_FILE) return res;
-    
-    s_printf(src_path, "%s/switch", staging);
-    res = folder_copy_with_progress_v2(src_path, "sd:/", "switch/");
-    if (res != FR_OK && res != FR_NO_FILE) return res;
-    
-    s_printf(src_path, "%s/warmboot_mariko", staging);
-    res = folder_copy_with_progress_v2(src_path, "sd:/", "warmboot_mariko/");
-    if (res != FR_OK && res != FR_NO_FILE) return res;
-    
-    // OC variant includes SaltySD (this is the large one with ~2500 files)
-    if (variant == VARIANT_OC) {
-        s_printf(src_path, "%s/SaltySD", staging);
-        res = folder_copy_with_progress_v2(src_path, "sd:/", "SaltySD/");
-        if (res != FR_OK && res != FR_NO_FILE) return res;
-    }
-    
-    // Copy root files
-    set_color(COLOR_CYAN);
-    gfx_printf("  Kopiere Root-Dateien...\n");
-    set_color(COLOR_WHITE);
-    
-    s_printf(src_path, "%s/boot.dat", staging);
-    s_printf(dst_path, "sd:/boot.dat");
-    if (path_exists(src_path)) {
-        file_copy(src_path, dst_path);
+    const char *zip_path = NULL;
+    omninx_variant_t zip_variant = VARIANT_NONE;
+    if (!path_exists(staging)) {
+        zip_path = zip_find(&zip_variant);
+        if (zip_variant != variant)
+            zip_path = NULL;
     }
     
-    s_printf(src_path, "%s/boot.ini", staging);
-    s_printf(dst_path, "sd:/boot.ini");
-    if (path_exists(src_path)) {
-        file_copy(src_path, dst_path);
-    }
-    
-    s_printf(src_path, "%s/exosphere.ini", staging);
-    s_printf(dst_path, "sd:/exosphere.ini");
-    if (path_exists(src_path)) {
-        file_copy(src_path, dst_path);
-    }
-    
-    s_printf(src_path, "%s/hbmenu.nro", staging);
-    s_printf(dst_path, "sd:/hbmenu.nro");
-    if (path_exists(src_path)) {
-        file_copy(src_path, dst_path);
-    }
-    
-    s_printf(src_path, "%s/loader.bin", staging);
-    s_printf(dst_path, "sd:/loader.bin");
-    if (path_exists(src_path)) {
-        file_copy(src_path, dst_path);
+    if (zip_path) {
+        res = install_from_zip(zip_path, variant);
+        if (res != FR_OK) return res;
+    } else {
+        s_printf(src_path, "%s/%s", staging, VERIFY_LIST_NAME);
+        verify_load_file(src_path);
+        
+        // Copy directories (use progress-aware copy for large directories)
+        for (int i = 0; pack_dirs[i] != NULL; i++) {
+            if (!pack_dir_wanted(pack_dirs[i], variant)) continue;
+            
+            s_printf(src_path, "%s/%s", staging, pack_dirs[i]);
+            s_printf(dst_path, "%s/", pack_dirs[i]);
+            res = folder_copy_with_progress_v2(src_path, "sd:/", dst_path);
+            if (res != FR_OK && res != FR_NO_FILE) return res;
+        }
+        
+        // Copy root files
+        u64 root_bytes = 0;
+        u32 root_files = 0;
+        bool root_ok = true;
+        for (int i = 0; pack_root_files[i] != NULL; i++) {
+            s_printf(src_path, "%s/%s", staging, pack_root_files[i]);
+            path_size(src_path, &root_bytes, &root_files);
+        }
+        
+        progress_begin(PROGRESS_COPY, "Root-Dateien", root_bytes, root_files);
+        for (int i = 0; pack_root_files[i] != NULL; i++) {
+            s_printf(src_path, "%s/%s", staging, pack_root_files[i]);
+            s_printf(dst_path, "sd:/%s", pack_root_files[i]);
+            if (path_exists(src_path) && file_copy(src_path, dst_path) != FR_OK) {
+                root_ok = false;
+            }
+        }
+        progress_end(root_ok);
     }
     
-    s_printf(src_path, "%s/payload.bin", staging);
-    s_printf(dst_path, "sd:/payload.bin");
-    if (path_exists(src_path)) {
-        file_copy(src_path, dst_path);
-    }
+    res = show_verify_result();
+    if (res != FR_OK) return res;
     
     // Create manifest.ini file
     set_color(COLOR_CYAN);
@@ -527,10 +588,13 @@ int update_mode_install(omninx_variant_t variant) {
 
 // Clean mode: Backup user data
 int clean_mode_backup(void) {
-    set_color(COLOR_CYAN);
-    gfx_printf("  Sichere: DBI, Tinfoil, prod.keys\n");
-    set_color(COLOR_WHITE);
+    u64 bytes = 0;
+    u32 files = 0;
+    
+    user_data_size("sd:/switch", &bytes, &files);
+    progress_begin(PROGRESS_BACKUP, "Benutzerdaten", bytes, files);
     int res = backup_user_data();
+    progress_end(res == FR_OK);
     if (res == FR_OK) {
         set_color(COLOR_GREEN);
         gfx_printf("  [OK] Sicherung abgeschlossen\n");
@@ -541,52 +605,28 @@ int clean_mode_backup(void) {
 
 // Clean mode: Wipe directories
 int clean_mode_wipe(void) {
+    static const char *wipe_dirs[] = { "atmosphere", "bootloader", "config", "switch", NULL };
+    char path[32];
+    char name[32];
     int res;
     
     // Delete entire directories
-    if (path_exists("sd:/atmosphere")) {
-        set_color(COLOR_CYAN);
-        gfx_printf("  Loesche: atmosphere/\n");
-        set_color(COLOR_WHITE);
-        res = folder_delete("sd:/atmosphere");
-        if (res != FR_OK && res != FR_NO_FILE) return res;
-    }
-    
-    if (path_exists("sd:/bootloader")) {
-        set_color(COLOR_CYAN);
-        gfx_printf("  Loesche: bootloader/\n");
-        set_color(COLOR_WHITE);
-        res = folder_delete("sd:/bootloader");
-        if (res != FR_OK && res != FR_NO_FILE) return res;
-    }
-    
-    if (path_exists("sd:/config")) {
-        set_color(COLOR_CYAN);
-        gfx_printf("  Loesche: config/\n");
-        set_color(COLOR_WHITE);
-        res = folder_delete("sd:/config");
-        if (res != FR_OK && res != FR_NO_FILE) return res;
-    }
-    
-    if (path_exists("sd:/switch")) {
-        set_color(COLOR_CYAN);
-        gfx_printf("  Loesche: switch/\n");
-        set_color(COLOR_WHITE);
-        res = folder_delete("sd:/switch");
+    for (int i = 0; wipe_dirs[i] != NULL; i++) {
+        s_printf(path, "sd:/%s", wipe_dirs[i]);
+        if (!path_exists(path)) continue;
+        
+        u64 bytes = 0;
+        u32 files = 0;
+        count_directory_items(path, &bytes, &files);
+        s_printf(name, "%s/", wipe_dirs[i]);
+        progress_begin(PROGRESS_DELETE, name, bytes, files);
+        res = folder_delete(path);
+        progress_end(res == FR_OK || res == FR_NO_FILE);
         if (res != FR_OK && res != FR_NO_FILE) return res;
     }
     
-    // Delete root files
-    set_color(COLOR_CYAN);
-    gfx_printf("  Bereinige: Root-Dateien\n");
-    set_color(COLOR_WHITE);
-    delete_path_list(root_files_to_delete, "root files");
-    
-    // Delete miscellaneous directories
-    delete_path_list(misc_dirs_to_delete, "misc dirs");
-    
-    // Delete miscellaneous files
-    delete_path_list(misc_files_to_delete, "misc files");
+    // Delete root and miscellaneous files
+    delete_path_lists("Root-Dateien", root_lists);
     
     // Recreate switch directory
     set_color(COLOR_CYAN);
@@ -603,10 +643,13 @@ int clean_mode_wipe(void) {
 
 // Clean mode: Restore user data
 int clean_mode_restore(void) {
-    set_color(COLOR_CYAN);
-    gfx_printf("  Stelle wieder her: DBI, Tinfoil, prod.keys\n");
-    set_color(COLOR_WHITE);
+    u64 bytes = 0;
+    u32 files = 0;
+    
+    user_data_size(TEMP_BACKUP_PATH, &bytes, &files);
+    progress_begin(PROGRESS_RESTORE, "Benutzerdaten", bytes, files);
     int res = restore_user_data();
+    progress_end(res == FR_OK);
     if (res == FR_OK) {
         set_color(COLOR_GREEN);
         gfx_printf("  [OK] Wiederherstellung abgeschlossen\n");
@@ -635,11 +678,13 @@ int cleanup_staging_directory(omninx_variant_t pack_variant) {
         set_color(COLOR_YELLOW);
         gfx_printf("\nEntferne Installationsordner...\n");
         set_color(COLOR_WHITE);
-        set_color(COLOR_CYAN);
-        gfx_printf("  Loesche: %s\n", staging);
-        set_color(COLOR_WHITE);
         
+        u64 bytes = 0;
+        u32 files = 0;
+        count_directory_items(staging, &bytes, &files);
+        progress_begin(PROGRESS_DELETE, staging + 4, bytes, files);
         int res = folder_delete(staging);
+        progress_end(res == FR_OK);
         if (res == FR_OK) {
             set_color(COLOR_GREEN);
             gfx_printf("  [OK] Installationsordner entfernt\n");
@@ -652,68 +697,205 @@ int cleanup_staging_directory(omninx_variant_t pack_variant) {
         return res;
     }
     
+    // Installed from the release ZIP: remove the archive like the staging folder
+    omninx_variant_t zip_variant = VARIANT_NONE;
+    const char *zip_path = zip_find(&zip_variant);
+    if (zip_path && zip_variant == pack_variant) {
+        set_color(COLOR_YELLOW);
+        gfx_printf("\nEntferne Installationsarchiv...\n");
+        set_color(COLOR_WHITE);
+        int res = f_unlink(zip_path);
+        if (res != FR_OK) {
+            set_color(COLOR_ORANGE);
+            gfx_printf("  [WARN] Archiv konnte nicht entfernt werden (err=%d)\n", res);
+            set_color(COLOR_WHITE);
+        }
+        return res;
+    }
+    
     return FR_OK;
 }
 
-// Main installation function
-int perform_installation(omninx_variant_t pack_variant, install_mode_t mode) {
+// What the install cost: time, card transfers after write shaping and heap
+// calls. Logged so changes to the copy and delete paths can be compared on
+// the same card and pack.
+typedef struct {
+    u32 start_ms;
+    u32 heap_calls;
+    u32 ms;
+    DSTATS disk;
+} install_stats_t;
+
+static install_stats_t install_stats;
+
+#ifdef DISK_TRACE
+#define DISK_TRACE_PATH "sd:/config/omninx/disk_trace.bin"
+#endif
+
+static void install_stats_begin(void) {
+    install_stats_t *st = &install_stats;
+    heap_monitor_t heap;
+
+    heap_monitor(&heap, false);
+    st->heap_calls = heap.calls;
+    disk_reset_stats();
+    fs_stats_begin();
+    st->start_ms = get_tmr_ms();
+}
+
+static void install_stats_log(int res) {
+    install_stats_t *st = &install_stats;
+    DSTATS *disk = &st->disk;
+    heap_monitor_t heap;
+
+    st->ms = get_tmr_ms() - st->start_ms;
+    heap_monitor(&heap, false);
+    disk_get_stats(disk);
+
+    log_write("STATS: %s after %d.%03d s\n", res == FR_OK ? "done" : "failed", st->ms / 1000, st->ms % 1000);
+    log_write("  SD reads: %d cmds, %d MB (%d sectors)\n", disk->rd_cmds, disk->rd_sectors >> 11, disk->rd_sectors);
+    log_write("  SD writes: %d cmds, %d MB (%d sectors)\n", disk->wr_cmds, disk->wr_sectors >> 11, disk->wr_sectors);
+    log_write("  SD erases: %d cmds\n", disk->erase_cmds);
+    log_write("  Heap: %d calls, %d KB in use\n", heap.calls - st->heap_calls, heap.used >> 10);
+    fs_stats_end();
+}
+
+void install_show_stats(void) {
+    install_stats_t *st = &install_stats;
+
+    set_color(COLOR_CYAN);
+    gfx_printf("\nDauer: %d s, SD: %d MB gelesen, %d MB geschrieben\n",
+        st->ms / 1000, st->disk.rd_sectors >> 11, st->disk.wr_sectors >> 11);
+    set_color(COLOR_WHITE);
+
+    fs_stats_print();
+    fs_stats_free();
+}
+
+static int install_run(omninx_variant_t pack_variant, install_mode_t mode) {
     int res;
+    // Each phase ends with an SD cache flush, so a power loss only loses the running phase.
+    // Bulk deletes also erase the freed clusters, so later writes don't pay for card GC.
     
     if (mode == INSTALL_MODE_UPDATE) {
-        // Update mode: selective cleanup then install
+        // With the inventory of the previous install only changed files are copied
+        // and only files dropped from the pack are deleted (after the copy).
+        fs_stats_phase("Bereinigung");
+        bool delta = inventory_load();
+        inventory_begin();
+        
         set_color(COLOR_YELLOW);
         gfx_printf("Schritt 1: Bereinigung...\n");
         set_color(COLOR_WHITE);
-        res = update_mode_cleanup(pack_variant);
-        if (res != FR_OK) return res;
+        if (delta) {
+            set_color(COLOR_CYAN);
+            gfx_printf("  Delta-Update: nur geaenderte Dateien\n");
+            set_color(COLOR_WHITE);
+        } else {
+            // Legacy install without inventory: selective cleanup then install
+            res = update_mode_cleanup(pack_variant);
+            if (res != FR_OK) return res;
+            sd_trim_flush();
+            sd_cache_flush();
+        }
         
         check_and_clear_screen_if_needed();
         gfx_printf("\n");
         set_color(COLOR_YELLOW);
         gfx_printf("Schritt 2: Dateien kopieren...\n");
         set_color(COLOR_WHITE);
+        fs_stats_phase("Kopieren");
         res = update_mode_install(pack_variant);
-        if (res != FR_OK) return res;
+        if (res != FR_OK) {
+            inventory_free();
+            return res;
+        }
+        if (delta) {
+            fs_stats_phase("Veraltete");
+            int stale = inventory_delete_stale();
+            set_color(COLOR_CYAN);
+            gfx_printf("  Veraltete Dateien entfernt: %d\n", stale);
+            set_color(COLOR_WHITE);
+            sd_trim_flush();
+        }
+        inventory_save();
+        sd_cache_flush();
         
         check_and_clear_screen_if_needed();
         // Remove staging directory
+        fs_stats_phase("Staging");
         res = cleanup_staging_directory(pack_variant);
+        sd_trim_flush();
+        sd_cache_flush();
         return res;
     } else {
         // Clean mode: backup, wipe, restore, install
         set_color(COLOR_YELLOW);
         gfx_printf("Schritt 1: Sichere Benutzerdaten...\n");
         set_color(COLOR_WHITE);
+        fs_stats_phase("Sichern");
         res = clean_mode_backup();
         if (res != FR_OK) return res;
+        sd_cache_flush();
         
         check_and_clear_screen_if_needed();
         gfx_printf("\n");
         set_color(COLOR_YELLOW);
         gfx_printf("Schritt 2: Bereinige alte Installation...\n");
         set_color(COLOR_WHITE);
+        fs_stats_phase("Loeschen");
         res = clean_mode_wipe();
         if (res != FR_OK) return res;
+        sd_trim_flush();
+        sd_cache_flush();
         
         check_and_clear_screen_if_needed();
         gfx_printf("\n");
         set_color(COLOR_YELLOW);
         gfx_printf("Schritt 3: Stelle Benutzerdaten wieder her...\n");
         set_color(COLOR_WHITE);
+        fs_stats_phase("Wiederherst.");
         res = clean_mode_restore();
         if (res != FR_OK) return res;
+        sd_cache_flush();
         
         check_and_clear_screen_if_needed();
         gfx_printf("\n");
         set_color(COLOR_YELLOW);
         gfx_printf("Schritt 4: Dateien kopieren...\n");
         set_color(COLOR_WHITE);
+        fs_stats_phase("Kopieren");
+        inventory_begin();
         res = clean_mode_install(pack_variant);
-        if (res != FR_OK) return res;
+        if (res != FR_OK) {
+            inventory_free();
+            return res;
+        }
+        inventory_save();
+        sd_cache_flush();
         
         check_and_clear_screen_if_needed();
         // Remove staging directory
+        fs_stats_phase("Staging");
         res = cleanup_staging_directory(pack_variant);
+        sd_trim_flush();
+        sd_cache_flush();
         return res;
     }
 }
+
+// Main installation function
+int perform_installation(omninx_variant_t pack_variant, install_mode_t mode) {
+    install_stats_begin();
+#ifdef DISK_TRACE
+    disk_trace_start();
+#endif
+    int res = install_run(pack_variant, mode);
+    install_stats_log(res);
+#ifdef DISK_TRACE
+    f_mkdir("sd:/config/omninx");
+    disk_trace_save(DISK_TRACE_PATH);
+#endif
+
+    return res;
+}
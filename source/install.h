@@ -15,6 +15,9 @@ typedef enum {
 // Main installation function
 int perform_installation(omninx_variant_t pack_variant, install_mode_t mode);
 
+// Time, SD traffic and filesystem call table of the last installation
+void install_show_stats(void);
+
 // Update mode operations
 int update_mode_cleanup(omninx_variant_t variant);
 int update_mode_install(omninx_variant_t variant);
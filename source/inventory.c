@@ -0,0 +1,482 @@
+/*
+ * OmniNX Installer - Installed file inventory and delta updates
+ *
+ * Every install records each file it put on the card as a path hash, its size,
+ * its start cluster and the CRC32 of its content, along with the directories
+ * holding them. On the next update a staged file whose path,
+ * size and CRC32 match the recorded entry, and whose installed copy still has
+ * that size, is not copied again. Only the files the old inventory lists but
+ * the new pack no longer contains are deleted afterwards, one recorded
+ * directory at a time, and directories left empty are removed. A point release
+ * that changes a handful of files then only writes those.
+ *
+ * A file whose start cluster differs from the recorded one was replaced by the
+ * user and is left alone. Installs without an inventory still go through the
+ * static lists of deletion_lists.h.
+ *
+ * The installed copy itself is not read back; a file the user edited in place
+ * without changing its size is not detected.
+ */
+
+#include "inventory.h"
+#include "fs.h"
+#include "sd_profile.h"
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
+#include <string.h>
+#include <utils/sprintf.h>
+#include <utils/util.h>
+
+#define INVENTORY_PATH    "sd:/config/omninx/inventory.bin"
+#define INVENTORY_MAGIC   0x4E564E49 // "INVN"
+#define INVENTORY_VERSION 2
+#define INVENTORY_GROW    1024
+#define INVENTORY_DIRS    1024
+#define INVENTORY_STR_SZ  0x10000 // Directory path storage
+
+typedef struct {
+    u32 hash;  // FNV-1a of the lower case path below sd:/
+    u32 size;
+    u32 crc;
+    u32 clust; // Start cluster of the installed file
+    u16 dir;   // Index of the containing directory
+    u16 rsvd;
+} inventory_entry_t;
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 rsvd;
+    u32 count;
+    u32 dir_count;
+    u32 str_size;  // Directory paths, NUL terminated, in dir index order
+} inventory_hdr_t;
+
+typedef struct {
+    inventory_entry_t *ents;
+    u32 count;
+    u32 cap;
+    char *strs;
+    u32 str_size;
+    u32 dir_count;
+    u16 dir_ofs[INVENTORY_DIRS]; // Offset of each directory path in strs
+} inventory_list_t;
+
+static inventory_list_t inv_old;
+static inventory_list_t inv_new;
+static bool inv_recording = false;
+static bool inv_new_sorted = false;
+
+u32 inventory_path_hash(const char *path) {
+    u32 hash = 0x811C9DC5;
+
+    if (!strncmp(path, "sd:", 3))
+        path += 3;
+
+    for (; *path; path++) {
+        char c = *path;
+        if (c == '/' && path[1] == '/')
+            continue;
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        hash = (hash ^ (u8)c) * 0x01000193;
+    }
+
+    return hash;
+}
+
+static void inventory_sift_down(inventory_entry_t *ents, u32 root, u32 count) {
+    while (root * 2 + 1 < count) {
+        u32 child = root * 2 + 1;
+        if (child + 1 < count && ents[child + 1].hash > ents[child].hash)
+            child++;
+        if (ents[root].hash >= ents[child].hash)
+            return;
+
+        inventory_entry_t tmp = ents[root];
+        ents[root] = ents[child];
+        ents[child] = tmp;
+        root = child;
+    }
+}
+
+static void inventory_sort(inventory_list_t *list) {
+    inventory_entry_t *ents = list->ents;
+    u32 count = list->count;
+
+    if (count < 2)
+        return;
+
+    for (u32 i = count / 2; i-- > 0;)
+        inventory_sift_down(ents, i, count);
+
+    for (u32 end = count - 1; end > 0; end--) {
+        inventory_entry_t tmp = ents[0];
+        ents[0] = ents[end];
+        ents[end] = tmp;
+        inventory_sift_down(ents, 0, end);
+    }
+}
+
+// Binary search, the list must be sorted
+static inventory_entry_t *inventory_find(inventory_list_t *list, u32 hash) {
+    u32 lo = 0;
+    u32 hi = list->count;
+
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if (list->ents[mid].hash == hash)
+            return &list->ents[mid];
+        if (list->ents[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return NULL;
+}
+
+// Index of the directory in the list (-1 if not there)
+static int inventory_dir_find(inventory_list_t *list, const char *dir, u32 len) {
+    static u32 last = 0;
+
+    // Files of the same directory usually come in a row
+    if (last < list->dir_count) {
+        const char *d = list->strs + list->dir_ofs[last];
+        if (!strncmp(d, dir, len) && !d[len])
+            return last;
+    }
+
+    for (u32 i = 0; i < list->dir_count; i++) {
+        const char *d = list->strs + list->dir_ofs[i];
+        if (!strncmp(d, dir, len) && !d[len]) {
+            last = i;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Index of the directory in the list, added if not there yet (-1 if the table is full)
+static int inventory_dir_index(inventory_list_t *list, const char *dir, u32 len) {
+    int idx = inventory_dir_find(list, dir, len);
+    if (idx >= 0)
+        return idx;
+
+    if (!list->strs)
+        list->strs = malloc(INVENTORY_STR_SZ);
+    if (!list->strs || list->dir_count >= INVENTORY_DIRS || list->str_size + len + 1 > INVENTORY_STR_SZ)
+        return -1;
+
+    list->dir_ofs[list->dir_count] = list->str_size;
+    memcpy(list->strs + list->str_size, dir, len);
+    list->strs[list->str_size + len] = 0;
+    list->str_size += len + 1;
+
+    return list->dir_count++;
+}
+
+static void inventory_list_free(inventory_list_t *list) {
+    free(list->ents);
+    free(list->strs);
+    memset(list, 0, sizeof(*list));
+}
+
+bool inventory_load(void) {
+    FIL fp;
+    UINT br = 0;
+    inventory_hdr_t hdr;
+
+    inventory_free();
+
+    if (f_open(&fp, INVENTORY_PATH, FA_READ) != FR_OK)
+        return false;
+
+    // Version 1 files had no directory table, those installs use the static lists
+    if (f_read(&fp, &hdr, sizeof(hdr), &br) != FR_OK || br != sizeof(hdr) ||
+        hdr.magic != INVENTORY_MAGIC || hdr.version != INVENTORY_VERSION ||
+        hdr.dir_count > INVENTORY_DIRS || hdr.str_size > INVENTORY_STR_SZ ||
+        f_size(&fp) != sizeof(hdr) + hdr.str_size + (u64)hdr.count * sizeof(inventory_entry_t)) {
+        f_close(&fp);
+        return false;
+    }
+
+    u32 bytes = hdr.count * sizeof(inventory_entry_t);
+    inv_old.strs = malloc(INVENTORY_STR_SZ);
+    inv_old.ents = malloc(bytes ? bytes : 1);
+    if (!inv_old.strs || !inv_old.ents ||
+        f_read(&fp, inv_old.strs, hdr.str_size, &br) != FR_OK || br != hdr.str_size ||
+        f_read(&fp, inv_old.ents, bytes, &br) != FR_OK || br != bytes) {
+        f_close(&fp);
+        inventory_free();
+        return false;
+    }
+    f_close(&fp);
+
+    // Rebuild the directory offsets
+    for (u32 ofs = 0; ofs < hdr.str_size && inv_old.dir_count < hdr.dir_count; ofs++) {
+        inv_old.dir_ofs[inv_old.dir_count++] = ofs;
+        while (ofs < hdr.str_size && inv_old.strs[ofs])
+            ofs++;
+    }
+    if (inv_old.dir_count != hdr.dir_count) {
+        inventory_free();
+        return false;
+    }
+
+    inv_old.count = hdr.count;
+    inv_old.cap = hdr.count;
+    inv_old.str_size = hdr.str_size;
+    inventory_sort(&inv_old);
+    log_write("INVENTORY: %d files in %d dirs from previous install\n", inv_old.count, inv_old.dir_count);
+
+    return true;
+}
+
+void inventory_begin(void) {
+    inventory_list_free(&inv_new);
+    inv_recording = true;
+    inv_new_sorted = false;
+}
+
+void inventory_add(const char *path, u32 size, u32 crc, u32 clust) {
+    if (!inv_recording)
+        return;
+
+    // Containing directory, keep the slash of the root
+    const char *slash = strrchr(path, '/');
+    u32 dir_len = slash ? (u32)(slash - path) : 0;
+    if (slash && (dir_len == 0 || path[dir_len - 1] == ':'))
+        dir_len++;
+
+    int dir = inventory_dir_index(&inv_new, path, dir_len);
+
+    if (dir >= 0 && inv_new.count >= inv_new.cap) {
+        u32 cap = inv_new.cap + INVENTORY_GROW;
+        inventory_entry_t *ents = malloc(cap * sizeof(inventory_entry_t));
+        if (ents) {
+            if (inv_new.ents)
+                memcpy(ents, inv_new.ents, inv_new.count * sizeof(inventory_entry_t));
+            free(inv_new.ents);
+            inv_new.ents = ents;
+            inv_new.cap = cap;
+        } else {
+            dir = -1;
+        }
+    }
+
+    if (dir < 0) {
+        // Without a complete record the next update must not trust it
+        log_write("INVENTORY: out of memory, not recorded\n");
+        inv_recording = false;
+        return;
+    }
+
+    inventory_entry_t *e = &inv_new.ents[inv_new.count++];
+    e->hash = inventory_path_hash(path);
+    e->size = size;
+    e->crc = crc;
+    e->clust = clust;
+    e->dir = dir;
+    e->rsvd = 0;
+    inv_new_sorted = false;
+}
+
+static int inventory_file_crc(const char *path, u32 *crc) {
+    FIL fp;
+    UINT br;
+    u32 buf_size = sd_profile_get()->copy_buf_size;
+
+    int res = f_open(&fp, path, FA_READ | FA_OPEN_EXISTING);
+    if (res != FR_OK)
+        return res;
+
+    u8 *buf = malloc(buf_size);
+    if (!buf) {
+        f_close(&fp);
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    *crc = 0;
+    while (1) {
+        res = f_read(&fp, buf, buf_size, &br);
+        if (res != FR_OK || !br)
+            break;
+        *crc = crc32_calc(*crc, buf, br);
+    }
+
+    free(buf);
+    f_close(&fp);
+
+    return res;
+}
+
+// Recorded entry of dst if the installed file still matches it in size and start cluster
+static inventory_entry_t *inventory_installed(const char *dst, u32 size, FILINFO *fno) {
+    if (!inv_old.count || !inv_recording)
+        return NULL;
+
+    inventory_entry_t *e = inventory_find(&inv_old, inventory_path_hash(dst));
+    if (!e || e->size != size)
+        return NULL;
+
+    if (f_stat(dst, fno) != FR_OK || (fno->fattrib & AM_DIR) || fno->fsize != size || fno->fclust != e->clust)
+        return NULL;
+
+    return e;
+}
+
+bool inventory_unchanged(const char *src, const char *dst, u32 size) {
+    FILINFO fno;
+    u32 crc;
+
+    inventory_entry_t *e = inventory_installed(dst, size, &fno);
+    if (!e)
+        return false;
+
+    if (inventory_file_crc(src, &crc) != FR_OK || crc != e->crc)
+        return false;
+
+    log_write("UNCHANGED: %s\n", dst);
+    inventory_add(dst, size, crc, fno.fclust);
+
+    return true;
+}
+
+bool inventory_unchanged_crc(const char *dst, u32 size, u32 crc) {
+    FILINFO fno;
+
+    inventory_entry_t *e = inventory_installed(dst, size, &fno);
+    if (!e || crc != e->crc)
+        return false;
+
+    log_write("UNCHANGED: %s\n", dst);
+    inventory_add(dst, size, crc, fno.fclust);
+
+    return true;
+}
+
+// Unlink the files of one recorded directory that the new pack does not contain
+static int inventory_delete_dir(const char *path) {
+    DIR dir;
+    FILINFO fno;
+    char sub[256];
+    int deleted = 0;
+    u32 len = strlen(path);
+
+    if (f_opendir(&dir, path) != FR_OK)
+        return 0;
+
+    while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0]) {
+        if (fno.fattrib & AM_DIR)
+            continue;
+
+        if (path[len - 1] == '/')
+            s_printf(sub, "%s%s", path, fno.fname);
+        else
+            s_printf(sub, "%s/%s", path, fno.fname);
+
+        // Skip files the user has replaced since (different start cluster)
+        u32 hash = inventory_path_hash(sub);
+        inventory_entry_t *e = inventory_find(&inv_old, hash);
+        if (e && e->clust == fno.fclust && !inventory_find(&inv_new, hash)) {
+            log_write("STALE: %s\n", sub);
+            if (f_unlink(sub) == FR_OK)
+                deleted++;
+        }
+    }
+
+    f_closedir(&dir);
+    return deleted;
+}
+
+int inventory_delete_stale(void) {
+    u16 order[INVENTORY_DIRS];
+    int deleted = 0;
+
+    if (!inv_old.count || !inv_recording)
+        return 0;
+
+    if (!inv_new_sorted) {
+        inventory_sort(&inv_new);
+        inv_new_sorted = true;
+    }
+
+    // Deepest directories first, so emptied parents can be removed after their children
+    for (u32 i = 0; i < inv_old.dir_count; i++) {
+        u32 len = strlen(inv_old.strs + inv_old.dir_ofs[i]);
+        u32 j = i;
+        while (j > 0 && strlen(inv_old.strs + inv_old.dir_ofs[order[j - 1]]) < len) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (u32 i = 0; i < inv_old.dir_count; i++) {
+        const char *path = inv_old.strs + inv_old.dir_ofs[order[i]];
+        u32 len = strlen(path);
+
+        deleted += inventory_delete_dir(path);
+
+        // Remove it if the new pack has no files there anymore (fails if not empty)
+        if (len > 4 && inventory_dir_find(&inv_new, path, len) < 0 && f_unlink(path) == FR_OK)
+            log_write("STALE DIR: %s\n", path);
+    }
+
+    log_write("INVENTORY: %d stale files deleted\n", deleted);
+
+    return deleted;
+}
+
+int inventory_save(void) {
+    FIL fp;
+    UINT bw;
+    inventory_hdr_t hdr;
+    int res;
+
+    if (!inv_recording) {
+        // Incomplete, make sure the next update does not trust an older record
+        f_unlink(INVENTORY_PATH);
+        inventory_free();
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    if (!inv_new_sorted) {
+        inventory_sort(&inv_new);
+        inv_new_sorted = true;
+    }
+
+    hdr.magic = INVENTORY_MAGIC;
+    hdr.version = INVENTORY_VERSION;
+    hdr.rsvd = 0;
+    hdr.count = inv_new.count;
+    hdr.dir_count = inv_new.dir_count;
+    hdr.str_size = inv_new.str_size;
+
+    f_mkdir("sd:/config/omninx");
+    res = f_open(&fp, INVENTORY_PATH, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res == FR_OK) {
+        res = f_write(&fp, &hdr, sizeof(hdr), &bw);
+        if (res == FR_OK && inv_new.str_size)
+            res = f_write(&fp, inv_new.strs, inv_new.str_size, &bw);
+        if (res == FR_OK && inv_new.count)
+            res = f_write(&fp, inv_new.ents, inv_new.count * sizeof(inventory_entry_t), &bw);
+        f_close(&fp);
+        if (res != FR_OK)
+            f_unlink(INVENTORY_PATH);
+    }
+
+    log_write("INVENTORY: %d files in %d dirs recorded (%s)\n", inv_new.count, inv_new.dir_count, fs_error_str(res));
+    inventory_free();
+
+    return res;
+}
+
+void inventory_free(void) {
+    inventory_list_free(&inv_old);
+    inventory_list_free(&inv_new);
+    inv_recording = false;
+    inv_new_sorted = false;
+}
@@ -0,0 +1,36 @@
+/*
+ * OmniNX Installer - Installed file inventory and delta updates
+ */
+
+#pragma once
+#include <utils/types.h>
+
+// FNV-1a of the lower case path below sd:/ (the "sd:" prefix is optional)
+u32 inventory_path_hash(const char *path);
+
+// Load the inventory of the previous install. Returns false if there is none
+// (first install or a version that did not write one), delta mode is then off.
+bool inventory_load(void);
+
+// Start recording the files of this install. Every file_copy() is added.
+void inventory_begin(void);
+
+// Add an installed file (dst path on the card, size, CRC32 of its content and start cluster)
+void inventory_add(const char *path, u32 size, u32 crc, u32 clust);
+
+// Delta mode: true if dst was installed from identical content before. The
+// staged file is read to compare its CRC32, its entry is then recorded as if
+// it had been copied.
+bool inventory_unchanged(const char *src, const char *dst, u32 size);
+
+// Same with the CRC32 already known (e.g. from a ZIP central directory)
+bool inventory_unchanged_crc(const char *dst, u32 size, u32 crc);
+
+// Delete the files of the previous install that the new pack does not contain
+// anymore, one recorded directory at a time, and remove the directories left
+// empty. Files replaced by the user are kept. Returns the number of deleted files.
+int inventory_delete_stale(void);
+
+// Write the recorded inventory next to manifest.ini and free all state
+int inventory_save(void);
+void inventory_free(void);
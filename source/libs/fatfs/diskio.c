@@ -13,9 +13,386 @@
 #include <string.h>
 
 #include <libs/fatfs/diskio.h>	/* FatFs lower layer API */
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
 #include <memory_map.h>
 #include <storage/nx_sd.h>
 #include <storage/sdmmc.h>
+#include <utils/util.h>
+
+/*-----------------------------------------------------------------------*/
+/* SD I/O trace (make DISK_TRACE=1)                                      */
+/*-----------------------------------------------------------------------*/
+/* Every disk_read/disk_write and sync from FatFs, and every transfer    */
+/* that then reaches the card, is recorded with its start time and       */
+/* duration into a DRAM ring. The ring keeps the newest entries and is   */
+/* saved with disk_trace_save(), for tools/disk_trace_replay.py.         */
+/*                                                                       */
+/* File: header of 8 u32 (magic, version, entries saved, entries         */
+/* recorded, AU sectors, shaping boundary and minimum), then the entries */
+/* oldest first. Entry: start us, duration us, sector, count | op << 24. */
+
+#ifdef DISK_TRACE
+#define DT_MAGIC	0x43525444	/* "DTRC" */
+#define DT_VERSION	1
+#define DT_ENTRIES	0x40000		/* 4MB ring. Power of 2. */
+
+enum
+{
+	DT_READ       = 0,	/* disk_read() */
+	DT_WRITE      = 1,	/* disk_write() */
+	DT_SYNC       = 2,	/* CTRL_SYNC */
+	DT_CARD_READ  = 3,	/* Transfers issued to the card. */
+	DT_CARD_WRITE = 4,
+	DT_CARD_ERASE = 5
+};
+
+typedef struct _dt_entry_t
+{
+	u32 start;
+	u32 dur;
+	u32 sector;
+	u32 count;
+} dt_entry_t;
+
+static dt_entry_t *dt_ring = NULL;
+static u32 dt_pos = 0;	/* Entries recorded, the ring index is this masked. */
+static bool dt_on = false;
+
+static u32 _dt_start(void)
+{
+	return dt_on ? get_tmr_us() : 0;
+}
+
+static void _dt_add(u32 op, DWORD sector, UINT count, u32 start)
+{
+	if (!dt_on)
+		return;
+
+	dt_entry_t *e = &dt_ring[dt_pos & (DT_ENTRIES - 1)];
+	e->start = start;
+	e->dur = get_tmr_us() - start;
+	e->sector = sector;
+	e->count = (count & 0xFFFFFF) | (op << 24);
+	dt_pos++;
+}
+#else
+#define _dt_start() 0
+#define _dt_add(op, sector, count, start) (void)(start)
+#endif
+
+/*-----------------------------------------------------------------------*/
+/* SD card access                                                        */
+/*-----------------------------------------------------------------------*/
+/* Every transfer to the card goes through these, so the counters show   */
+/* what an install really costs, after write shaping.                    */
+
+static DSTATS dstats;
+
+static int _sd_read(DWORD sector, UINT count, void *buf)
+{
+	u32 t = _dt_start();
+	dstats.rd_cmds++;
+	dstats.rd_sectors += count;
+	int res = sdmmc_storage_read(&sd_storage, sector, count, buf);
+	_dt_add(DT_CARD_READ, sector, count, t);
+
+	return res;
+}
+
+static int _sd_write(DWORD sector, UINT count, const void *buf)
+{
+	u32 t = _dt_start();
+	dstats.wr_cmds++;
+	dstats.wr_sectors += count;
+	int res = sdmmc_storage_write(&sd_storage, sector, count, (void *)buf);
+	_dt_add(DT_CARD_WRITE, sector, count, t);
+
+	return res;
+}
+
+void disk_get_stats(DSTATS *st)
+{
+	memcpy(st, &dstats, sizeof(DSTATS));
+}
+
+void disk_reset_stats(void)
+{
+	memset(&dstats, 0, sizeof(DSTATS));
+}
+
+/*-----------------------------------------------------------------------*/
+/* SD write shaping                                                      */
+/*-----------------------------------------------------------------------*/
+/* Sequential writes are collected in a DRAM buffer and issued in large  */
+/* chunks that end on allocation unit boundaries. Any write that does    */
+/* not continue the current run, a read overlapping it or a sync flushes */
+/* the run first, so metadata always reaches the card after the data it  */
+/* refers to.                                                            */
+
+#define WS_BUF_SECTORS	0x4000	/* 8MB staging buffer. */
+
+static u8  *ws_buf = NULL;
+static u32  ws_sector = 0;	/* First sector held in the buffer. */
+static u32  ws_count = 0;	/* Sectors held in the buffer. */
+static u32  ws_align = 0;	/* Flush boundary in sectors (power of 2). */
+static u32  ws_shape = 0x2000;	/* Wanted flush size, set with CTRL_SET_SHAPING. */
+static u32  ws_min = 8;		/* Smaller writes that do not extend a run pass through (FAT/dir sectors). */
+static bool ws_disabled = false;
+
+static u32 _ws_get_au_sectors(void)
+{
+	u32 au = sd_storage_get_ssr_au(&sd_storage) * 2; // KB to sectors.
+
+	return au ? au : 32768; // Default to 16MB.
+}
+
+static void _ws_set_align(void)
+{
+	// Use the biggest power of 2 that fits the AU, the wanted chunk and the buffer.
+	u32 limit = MIN(MIN(_ws_get_au_sectors(), ws_shape), WS_BUF_SECTORS);
+	ws_align = 1;
+	while ((ws_align << 1) <= limit)
+		ws_align <<= 1;
+}
+
+static bool _ws_init(void)
+{
+	if (ws_buf)
+		return true;
+	if (ws_disabled)
+		return false;
+
+	ws_buf = (u8 *)malloc(WS_BUF_SECTORS * 512);
+	if (!ws_buf)
+	{
+		ws_disabled = true;
+		return false;
+	}
+
+	_ws_set_align();
+
+	return true;
+}
+
+static DRESULT _ws_flush(void)
+{
+	if (!ws_count)
+		return RES_OK;
+
+	u32 count = ws_count;
+	ws_count = 0;
+
+	return _sd_write(ws_sector, count, ws_buf) ? RES_OK : RES_ERROR;
+}
+
+/* Write out everything up to the last flush boundary inside the run. */
+static DRESULT _ws_flush_aligned(void)
+{
+	u32 end = ALIGN_DOWN(ws_sector + ws_count, ws_align);
+	if (end <= ws_sector)
+	{
+		// No boundary in a full buffer. Write it all.
+		if (ws_count == WS_BUF_SECTORS)
+			return _ws_flush();
+		return RES_OK;
+	}
+
+	u32 count = end - ws_sector;
+	if (!_sd_write(ws_sector, count, ws_buf))
+	{
+		ws_count = 0;
+		return RES_ERROR;
+	}
+
+	ws_count -= count;
+	ws_sector = end;
+	if (ws_count)
+		memmove(ws_buf, ws_buf + count * 512, ws_count * 512);
+
+	return RES_OK;
+}
+
+static DRESULT _ws_write(const BYTE *buff, DWORD sector, UINT count)
+{
+	DRESULT res;
+
+	// Not a continuation of the current run.
+	if (!ws_count || sector != ws_sector + ws_count)
+	{
+		res = _ws_flush();
+		if (res != RES_OK)
+			return res;
+
+		if (count < ws_min)
+			return _sd_write(sector, count, buff) ? RES_OK : RES_ERROR;
+
+		// Already aligned. Write the aligned part directly and keep the tail.
+		if (!(sector & (ws_align - 1)) && count >= ws_align)
+		{
+			u32 direct = ALIGN_DOWN(count, ws_align);
+			if (!_sd_write(sector, direct, buff))
+				return RES_ERROR;
+
+			sector += direct;
+			buff += direct * 512;
+			count -= direct;
+			if (!count)
+				return RES_OK;
+		}
+
+		ws_sector = sector;
+	}
+
+	while (count)
+	{
+		u32 chunk = MIN(count, WS_BUF_SECTORS - ws_count);
+		memcpy(ws_buf + ws_count * 512, buff, chunk * 512);
+		ws_count += chunk;
+		buff += chunk * 512;
+		count -= chunk;
+
+		if (ws_count >= ws_align || ws_count == WS_BUF_SECTORS)
+		{
+			res = _ws_flush_aligned();
+			if (res != RES_OK)
+				return res;
+		}
+	}
+
+	return RES_OK;
+}
+
+/*-----------------------------------------------------------------------*/
+/* SD trim queue                                                         */
+/*-----------------------------------------------------------------------*/
+/* Cluster ranges freed by FatFs are only queued here. They are merged,  */
+/* shrunk to whole allocation units and erased on CTRL_TRIM_FLUSH, after */
+/* a bulk delete finished. Writes clip any queued range they overlap, so */
+/* reallocated clusters are never erased.                                */
+
+#if FF_USE_TRIM
+#define TRIM_MAX_RANGES	128
+
+typedef struct _trim_range_t
+{
+	DWORD start;
+	DWORD end; /* Inclusive. */
+} trim_range_t;
+
+static trim_range_t trim_q[TRIM_MAX_RANGES];
+static u32 trim_cnt = 0;
+
+static DRESULT _trim_flush(void)
+{
+	if (!trim_cnt)
+		return RES_OK;
+
+	// Erase must not race data still held in the write buffer.
+	DRESULT res = _ws_flush();
+	if (res != RES_OK)
+	{
+		trim_cnt = 0;
+		return res;
+	}
+
+	// Sort by start sector and coalesce adjacent ranges.
+	for (u32 i = 1; i < trim_cnt; i++)
+	{
+		trim_range_t r = trim_q[i];
+		u32 j = i;
+		while (j && trim_q[j - 1].start > r.start)
+		{
+			trim_q[j] = trim_q[j - 1];
+			j--;
+		}
+		trim_q[j] = r;
+	}
+
+	u32 cnt = 0;
+	for (u32 i = 1; i < trim_cnt; i++)
+	{
+		if (trim_q[i].start <= trim_q[cnt].end + 1)
+			trim_q[cnt].end = MAX(trim_q[cnt].end, trim_q[i].end);
+		else
+			trim_q[++cnt] = trim_q[i];
+	}
+	cnt++;
+	trim_cnt = 0;
+
+	// Only erase whole AUs. Partial ones are left to the card.
+	u32 au = _ws_get_au_sectors();
+	for (u32 i = 0; i < cnt; i++)
+	{
+		u32 start = ALIGN(trim_q[i].start, au);
+		u32 end = ALIGN_DOWN(trim_q[i].end + 1, au);
+		if (end > start)
+		{
+			u32 t = _dt_start();
+			dstats.erase_cmds++;
+			sd_storage_erase(&sd_storage, start, end - start);
+			_dt_add(DT_CARD_ERASE, start, end - start, t);
+		}
+	}
+
+	return RES_OK;
+}
+
+static void _trim_add(DWORD start, DWORD end)
+{
+	// Extend a queued range if the new one touches it.
+	for (u32 i = 0; i < trim_cnt; i++)
+	{
+		if (start <= trim_q[i].end + 1 && end + 1 >= trim_q[i].start)
+		{
+			trim_q[i].start = MIN(trim_q[i].start, start);
+			trim_q[i].end = MAX(trim_q[i].end, end);
+			return;
+		}
+	}
+
+	if (trim_cnt == TRIM_MAX_RANGES)
+		_trim_flush();
+
+	trim_q[trim_cnt].start = start;
+	trim_q[trim_cnt].end = end;
+	trim_cnt++;
+}
+
+static void _trim_clip(DWORD sector, UINT count)
+{
+	DWORD end = sector + count - 1;
+
+	for (u32 i = 0; i < trim_cnt; i++)
+	{
+		trim_range_t *r = &trim_q[i];
+		if (sector > r->end || end < r->start)
+			continue;
+
+		if (sector <= r->start && end >= r->end)
+		{
+			// Fully rewritten.
+			*r = trim_q[--trim_cnt];
+			i--;
+		}
+		else if (sector <= r->start)
+			r->start = end + 1;
+		else if (end >= r->end)
+			r->end = sector - 1;
+		else
+		{
+			// Split in two. Drop the tail if there's no room.
+			if (trim_cnt < TRIM_MAX_RANGES)
+			{
+				trim_q[trim_cnt].start = end + 1;
+				trim_q[trim_cnt].end = r->end;
+				trim_cnt++;
+			}
+			r->end = sector - 1;
+		}
+	}
+}
+#endif
 
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
@@ -48,7 +425,21 @@ DRESULT disk_read (
 )
 {
 	if (pdrv == DRIVE_SD)
-		return sdmmc_storage_read(&sd_storage, sector, count, buff) ? RES_OK : RES_ERROR;
+	{
+		u32 t = _dt_start();
+
+		// Reads must see buffered data.
+		if (ws_count && sector < ws_sector + ws_count && sector + count > ws_sector)
+		{
+			if (_ws_flush() != RES_OK)
+				return RES_ERROR;
+		}
+
+		DRESULT res = _sd_read(sector, count, buff) ? RES_OK : RES_ERROR;
+		_dt_add(DT_READ, sector, count, t);
+
+		return res;
+	}
 
 	return RES_ERROR;
 }
@@ -64,7 +455,22 @@ DRESULT disk_write (
 )
 {
 	if (pdrv == DRIVE_SD)
-		return sdmmc_storage_write(&sd_storage, sector, count, (void *)buff) ? RES_OK : RES_ERROR;
+	{
+		DRESULT res;
+		u32 t = _dt_start();
+
+#if FF_USE_TRIM
+		_trim_clip(sector, count);
+#endif
+
+		if (_ws_init())
+			res = _ws_write(buff, sector, count);
+		else
+			res = _sd_write(sector, count, buff) ? RES_OK : RES_ERROR;
+		_dt_add(DT_WRITE, sector, count, t);
+
+		return res;
+	}
 
 	return RES_ERROR;
 }
@@ -85,11 +491,35 @@ DRESULT disk_ioctl (
 	{
 		switch (cmd)
 		{
+		case CTRL_SYNC:
+		{
+			u32 t = _dt_start();
+			DRESULT res = _ws_flush();
+			_dt_add(DT_SYNC, 0, 0, t);
+			return res;
+		}
+#if FF_USE_TRIM
+		case CTRL_TRIM:
+			_trim_add(buf[0], buf[1]);
+			break;
+		case CTRL_TRIM_FLUSH:
+			return _trim_flush();
+#endif
+		case CTRL_SET_SHAPING:
+		{
+			// Runs already collected keep the old boundary.
+			DRESULT res = _ws_flush();
+			ws_shape = buf[0];
+			ws_min = buf[1];
+			if (ws_buf)
+				_ws_set_align();
+			return res;
+		}
 		case GET_SECTOR_COUNT:
 			*buf = sd_storage.sec_cnt - part_rsvd_size;
 			break;
 		case GET_BLOCK_SIZE:
-			*buf = 32768; // Align to 16MB.
+			*buf = _ws_get_au_sectors(); // Align to AU.
 			break;
 		}
 	}
@@ -108,3 +538,49 @@ DRESULT disk_ioctl (
 
 	return RES_OK;
 }
+
+#ifdef DISK_TRACE
+/*-----------------------------------------------------------------------*/
+/* SD I/O trace control                                                  */
+/*-----------------------------------------------------------------------*/
+bool disk_trace_start(void)
+{
+	if (!dt_ring)
+		dt_ring = (dt_entry_t *)malloc(DT_ENTRIES * sizeof(dt_entry_t));
+
+	dt_pos = 0;
+	dt_on = dt_ring != NULL;
+
+	return dt_on;
+}
+
+int disk_trace_save(const char *path)
+{
+	FIL fp;
+	UINT bw;
+
+	if (!dt_ring)
+		return FR_NOT_ENOUGH_CORE;
+
+	// Saving goes through disk_write too.
+	dt_on = false;
+
+	// Oldest first. Once the ring wrapped, it starts at the write position.
+	u32 cnt = MIN(dt_pos, DT_ENTRIES);
+	u32 first = dt_pos > DT_ENTRIES ? dt_pos & (DT_ENTRIES - 1) : 0;
+	u32 hdr[8] = { DT_MAGIC, DT_VERSION, cnt, dt_pos, _ws_get_au_sectors(), ws_align, ws_min, 0 };
+
+	int res = f_open(&fp, path, FA_WRITE | FA_CREATE_ALWAYS);
+	if (res != FR_OK)
+		return res;
+
+	res = f_write(&fp, hdr, sizeof(hdr), &bw);
+	if (res == FR_OK)
+		res = f_write(&fp, &dt_ring[first], (cnt - first) * sizeof(dt_entry_t), &bw);
+	if (res == FR_OK && first)
+		res = f_write(&fp, dt_ring, first * sizeof(dt_entry_t), &bw);
+	f_close(&fp);
+
+	return res;
+}
+#endif
@@ -51,7 +51,7 @@
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_EXPAND	0
+#define FF_USE_EXPAND	1
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
@@ -122,6 +122,18 @@
 /  ff_memfree() in ffsystem.c, need to be added to the project. */
 
 
+#define FF_NAMBUF_DEPTH	2
+/* Number of LFN working buffers preallocated on the BSS when FF_USE_LFN == 3
+/  (0 to 8). Path functions take one of these instead of calling ff_memalloc()
+/  and fall back to the heap only when all of them are in use. A single API call
+/  holds at most one buffer, so more than 1 is only needed if FatFs is re-entered,
+/  e.g. from within a disk I/O callback.
+/  The buffers are one static pool in ff.c, shared by all volumes instead of
+/  being part of FATFS, and taking or returning one is not locked. Volumes can be
+/  mounted together, but only one may be in use at a time: FatFs must not be
+/  called from two threads, so a non-zero depth needs FF_FS_REENTRANT == 0. */
+
+
 #define FF_LFN_UNICODE	0
 /* This option switches the character encoding on the API when LFN is enabled.
 /
@@ -206,7 +218,7 @@
 /  GET_SECTOR_SIZE command. */
 
 
-#define FF_USE_TRIM		0
+#define FF_USE_TRIM		1
 /* This option switches support for ATA-TRIM. (0:Disable or 1:Enable)
 /  To enable Trim function, also CTRL_TRIM command should be implemented to the
 /  disk_ioctl() function. */
@@ -224,6 +236,26 @@
 */
 
 
+#define FF_FAT_CACHE		1
+#define FF_FAT_CACHE_ADDR	0xA4000000
+#define FF_FAT_CACHE_SZ		0x0C000000	/* Up to PSTORE_ADDR (0xB0000000) */
+/* This option keeps the whole FAT of a FAT32 volume, or the allocation bitmap of
+/  an exFAT volume, resident in DRAM at FF_FAT_CACHE_ADDR (0:Disable or 1:Enable).
+/  It is read at mount with large transfers. Allocation scans 32 clusters per step
+/  and free space queries need no disk access. Dirty sectors are written back in
+/  batches by sync_fs(). Only one volume is cached. The region is the start of the
+/  RAM disk area, below the L4T PSTORE at 0xB0000000 and the payload chainloaded
+/  by launch_payload() at 0xC0000000, which is read while the volume is mounted.
+/  A FAT that does not fit is not cached and is used from the card as before. */
+
+
+#define FF_DIR_HINTS	8
+/* Number of directories whose free entry cursor is remembered (0:Disable).
+/  dir_alloc() resumes after the last block it allocated in the directory instead
+/  of scanning from entry 0, so filling a directory costs linear directory I/O.
+/  The cursors are dropped on any entry removal and on mount. */
+
+
 
 /*---------------------------------------------------------------------------/
 / System Configurations
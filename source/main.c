@@ -2,6 +2,10 @@
  * OmniNX Installer Payload
  * Minimal payload to install OmniNX CFW Pack files outside of Horizon OS
  *
+ * This is the stub that runs from IRAM: it brings up the hardware and the
+ * display, loads the installer engine (engine.c) from the SD card into DRAM
+ * and chainloads hekate once the engine is done.
+ *
  * Based on TegraExplorer/hekate by CTCaer, naehrwert, shchmue
  * Based on HATS-Installer-Payload by sthetix
  */
@@ -28,14 +32,9 @@
 #include <utils/btn.h>
 #include <utils/util.h>
 #include <utils/sprintf.h>
-#include <input/joycon.h>
-
-#include "fs.h"
-#include "version.h"
-#include "install.h"
+#include <ianos/ianos.h>
 
-// Configuration
-#define PAYLOAD_PATH      "sd:/bootloader/update.bin"
+#include "engine.h"
 
 // Payload launch defines
 #define RELOC_META_OFF      0x7C
@@ -72,7 +71,6 @@ boot_cfg_t __attribute__((section ("._boot_cfg"))) b_cfg;
 volatile nyx_storage_t *nyx_str = (nyx_storage_t *)NYX_STORAGE_ADDR;
 
 static void *coreboot_addr;
-static int total_errors = 0;
 
 // Use BDK colors (already defined in types.h)
 #define COLOR_CYAN    0xFF00FFFF
@@ -212,247 +210,37 @@ void ipl_main(void) {
 
     print_header();
 
-    // Detect current OmniNX installation
-    omninx_status_t current = detect_omninx_installation();
-    
-    // Detect which pack variant is on SD card
-    omninx_variant_t pack_variant = detect_pack_variant();
-    
-    if (pack_variant == VARIANT_NONE) {
+    // Run the installer engine, it returns here when done
+    engine_cfg_t cfg = { ENGINE_MAGIC, VERSION, sd_end, ENGINE_NOT_RUN };
+    ianos_loader(ENGINE_PATH, EXEC_ELF, &cfg);
+
+    if (cfg.result == ENGINE_NOT_RUN) {
+        sd_mount();
+
         set_color(COLOR_RED);
-        gfx_printf("FEHLER: Kein OmniNX-Paket auf der SD-Karte gefunden!\n");
-        gfx_printf("Erwartet wird eines der folgenden:\n");
-        gfx_printf("  - sd:/OmniNX Standard/\n");
-        gfx_printf("  - sd:/OmniNX Light/\n");
-        gfx_printf("  - sd:/OmniNX OC/\n\n");
-        set_color(COLOR_WHITE);
-        
-        // Initialize joycons for button input
-        jc_init_hw();
-        
-        // Wait for button confirmation
-        bool button_pressed = false;
-        
-        // Launch payload if available
-        if (file_exists(PAYLOAD_PATH)) {
-            set_color(COLOR_GREEN);
-            gfx_printf("Druecke A-Taste (rechter Joy-Con) oder Power-Taste,\n");
-            gfx_printf("um Hekate zu starten...\n");
-            set_color(COLOR_WHITE);
-        } else {
-            set_color(COLOR_GREEN);
-            gfx_printf("Druecke A-Taste (rechter Joy-Con) oder Power-Taste,\n");
-            gfx_printf("um den Neustart zu starten...\n");
-            set_color(COLOR_WHITE);
-        }
-        
-        // First, wait for power button to be released if it's currently pressed
-        while (btn_read() & BTN_POWER) {
-            msleep(50);
-        }
-        
-        while (!button_pressed) {
-            // Check power button
-            u8 btn_state = btn_read();
-            if (btn_state & BTN_POWER) {
-                button_pressed = true;
-                break;
-            }
-            
-            // Check joycon A button
-            jc_gamepad_rpt_t *jc = joycon_poll();
-            if (jc && jc->a) {
-                button_pressed = true;
-                break;
-            }
-            
-            msleep(50); // Small delay to avoid busy-waiting
-        }
-        
-        // Launch payload if available, otherwise reboot
-        if (file_exists(PAYLOAD_PATH)) {
-            gfx_printf("\n");
-            set_color(COLOR_CYAN);
-            gfx_printf("Payload wird gestartet...\n");
-            set_color(COLOR_WHITE);
-            msleep(500);
-            launch_payload(PAYLOAD_PATH);
-        } else {
-            power_set_state(POWER_OFF_REBOOT);
-        }
-        return;
-    }
-    
-    // Determine installation mode
-    install_mode_t mode = current.is_installed ? INSTALL_MODE_UPDATE : INSTALL_MODE_CLEAN;
-    
-    // Show information
-    set_color(COLOR_CYAN);
-    gfx_printf("Installationsmodus: %s\n", mode == INSTALL_MODE_UPDATE ? "Update" : "Saubere Installation");
-    gfx_printf("Paket-Variante: %s\n", get_variant_name(pack_variant));
-    if (current.is_installed) {
-        gfx_printf("Aktuelle Installation: %s\n", get_variant_name(current.variant));
-    } else {
-        gfx_printf("Aktuelle Installation: Keine\n");
-    }
-    set_color(COLOR_WHITE);
-    gfx_printf("\n");
-    
-    // Initialize joycons for button input
-    jc_init_hw();
-    
-    // Intro section - wait for user confirmation
-    set_color(COLOR_YELLOW);
-    gfx_printf("Bereit zum Installieren/Aktualisieren.\n");
-    set_color(COLOR_WHITE);
-    gfx_printf("\n");
-    set_color(COLOR_GREEN);
-    gfx_printf("Druecke A-Taste (rechter Joy-Con) oder Power-Taste,\n");
-    gfx_printf("um die Installation zu starten...\n");
-    set_color(COLOR_WHITE);
-    
-    // Wait for either A button or Power button
-    bool button_pressed = false;
-    
-    // First, wait for power button to be released if it's currently pressed
-    while (btn_read() & BTN_POWER) {
-        msleep(50);
-    }
-    
-    while (!button_pressed) {
-        // Check power button - detect press (transition from not pressed to pressed)
-        u8 btn_state = btn_read();
-        if (btn_state & BTN_POWER) {
-            button_pressed = true;
-            break;
-        }
-        
-        // Check joycon A button
-        jc_gamepad_rpt_t *jc = joycon_poll();
-        if (jc && jc->a) {
-            button_pressed = true;
-            break;
-        }
-        
-        msleep(50); // Small delay to avoid busy-waiting
-    }
-    
-    // Clear the prompt and start installation
-    gfx_clear_grey(0x1B);
-    gfx_con_setpos(0, 0);
-    print_header();
-    
-    // Perform the installation
-    set_color(COLOR_YELLOW);
-    gfx_printf("Installation wird gestartet...\n\n");
-    set_color(COLOR_WHITE);
-    
-    int result = perform_installation(pack_variant, mode);
-    
-    // Clear screen for final summary to ensure it's visible
-    gfx_clear_grey(0x1B);
-    gfx_con_setpos(0, 0);
-    
-    // Summary
-    set_color(COLOR_CYAN);
-    gfx_printf("========================================\n");
-    gfx_printf("  OmniNX Installer Payload v%s\n", VERSION);
-    gfx_printf("========================================\n\n");
-    set_color(COLOR_WHITE);
-    
-    if (result == FR_OK && total_errors == 0) {
+        gfx_printf("FEHLER: Installer-Engine fehlt oder passt nicht!\n");
+        gfx_printf("Pfad: %s\n", ENGINE_PATH);
+        gfx_printf("Bitte das komplette Release-Archiv auf die SD-Karte\n");
+        gfx_printf("entpacken.\n\n");
         set_color(COLOR_GREEN);
-        gfx_printf("========================================\n");
-        gfx_printf("    Installation abgeschlossen!\n");
-        gfx_printf("========================================\n");
-    } else {
-        set_color(COLOR_RED);
-        gfx_printf("========================================\n");
-        gfx_printf("    Installation beendet\n");
-        if (total_errors > 0) {
-            gfx_printf("    %d Fehler\n", total_errors);
-        }
-        gfx_printf("========================================\n");
-    }
-    set_color(COLOR_WHITE);
-    
-    // Wait for user input before launching payload
-    gfx_printf("\n");
-    set_color(COLOR_GREEN);
-    gfx_printf("Druecke A-Taste (rechter Joy-Con) oder Power-Taste,\n");
-    gfx_printf("um Hekate zu starten...\n");
-    set_color(COLOR_WHITE);
-    
-    // Wait for either A button or Power button (reuse button_pressed variable)
-    button_pressed = false;
-    
-    // First, wait for power button to be released if it's currently pressed
-    while (btn_read() & BTN_POWER) {
-        msleep(50);
-    }
-    
-    while (!button_pressed) {
-        // Check power button - detect press (transition from not pressed to pressed)
-        u8 btn_state = btn_read();
-        if (btn_state & BTN_POWER) {
-            // Power button is pressed
-            button_pressed = true;
-            break;
-        }
-        
-        // Check joycon A button
-        jc_gamepad_rpt_t *jc = joycon_poll();
-        if (jc && jc->a) {
-            button_pressed = true;
-            break;
-        }
-        
-        msleep(50); // Small delay to avoid busy-waiting
-    }
-    
-    gfx_printf("\n");
-    set_color(COLOR_CYAN);
-    gfx_printf("Payload wird gestartet...\n");
-    set_color(COLOR_WHITE);
-    msleep(500); // Brief delay before launch
-    
-    if (file_exists(PAYLOAD_PATH)) {
-        launch_payload(PAYLOAD_PATH);
-    } else {
-        // Payload not found, show error
-        set_color(COLOR_RED);
-        gfx_printf("\nFEHLER: Payload nicht gefunden!\n");
-        gfx_printf("Pfad: %s\n", PAYLOAD_PATH);
+        gfx_printf("Druecke die Power-Taste, um %s...\n",
+            file_exists(PAYLOAD_PATH) ? "Hekate zu starten" : "den Neustart zu starten");
         set_color(COLOR_WHITE);
-        gfx_printf("\nDruecke A oder Power zum Neustart...\n");
-        
-        // Wait for button again
-        button_pressed = false;
-        
-        // Wait for power button to be released if pressed
-        while (btn_read() & BTN_POWER) {
+
+        // Joy-Cons are only set up by the engine
+        while (btn_read() & BTN_POWER)
             msleep(50);
-        }
-        
-        while (!button_pressed) {
-            u8 btn_state = btn_read();
-            if (btn_state & BTN_POWER) {
-                button_pressed = true;
-                break;
-            }
-            
-            jc_gamepad_rpt_t *jc = joycon_poll();
-            if (jc && jc->a) {
-                button_pressed = true;
-                break;
-            }
-            
+        while (!(btn_read() & BTN_POWER))
             msleep(50);
-        }
-        
-        power_set_state(POWER_OFF_REBOOT);
+
+        cfg.result = file_exists(PAYLOAD_PATH) ? ENGINE_LAUNCH : ENGINE_REBOOT;
     }
-    
+
+    if (cfg.result == ENGINE_LAUNCH)
+        launch_payload(PAYLOAD_PATH);
+    else
+        power_set_state(POWER_OFF_REBOOT);
+
     // Should never reach here
     while (1)
         bpmp_halt();
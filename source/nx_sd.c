@@ -19,12 +19,15 @@
 #include <storage/sdmmc.h>
 #include <storage/sdmmc_driver.h>
 #include <gfx_utils.h>
+#include <libs/fatfs/diskio.h>
 #include <libs/fatfs/ff.h>
 #include <mem/heap.h>
+#include <memory_map.h>
 
 bool sd_mounted = false;
 static u16  sd_errors[3] = { 0 }; // Init and Read/Write errors.
 static u32  sd_mode = SD_UHS_SDR82;
+static u32  sd_mode_skip = 0; // Bus modes known to be unstable on the inserted card.
 
 sdmmc_t sd_sdmmc;
 sdmmc_storage_t sd_storage;
@@ -64,6 +67,15 @@ u32 sd_get_mode()
 	return sd_mode;
 }
 
+void sd_set_mode(u32 mode, u32 skip_mask)
+{
+	if (mode > SD_UHS_SDR82)
+		mode = SD_UHS_SDR82;
+
+	sd_mode = mode;
+	sd_mode_skip = skip_mask;
+}
+
 int sd_init_retry(bool power_cycle)
 {
 	u32 bus_width = SDMMC_BUS_WIDTH_4;
@@ -73,6 +85,11 @@ int sd_init_retry(bool power_cycle)
 	if (power_cycle)
 	{
 		sd_mode--;
+
+		// Do not retry modes that already failed on this card.
+		while (sd_mode > SD_INIT_FAIL && (sd_mode_skip & BIT(sd_mode)))
+			sd_mode--;
+
 		sdmmc_storage_end(&sd_storage);
 	}
 
@@ -167,6 +184,35 @@ bool sd_mount()
 	return false;
 }
 
+bool sd_cache_enable()
+{
+	if (!sd_mounted)
+		return false;
+
+	return sd_storage_enable_cache(&sd_storage, (u8 *)SDMMC_UPPER_BUFFER);
+}
+
+bool sd_cache_flush()
+{
+	if (!sd_mounted)
+		return true;
+
+	// Buffered writes must reach the card before its cache is flushed.
+	if (disk_ioctl(DRIVE_SD, CTRL_SYNC, NULL) != RES_OK)
+		return false;
+
+	return sd_storage_flush_cache(&sd_storage, (u8 *)SDMMC_UPPER_BUFFER);
+}
+
+bool sd_trim_flush()
+{
+	if (!sd_mounted)
+		return true;
+
+	// Erase the cluster ranges freed since the last call.
+	return disk_ioctl(DRIVE_SD, CTRL_TRIM_FLUSH, NULL) == RES_OK;
+}
+
 static void _sd_deinit()
 {
 	if (sd_mode == SD_INIT_FAIL)
@@ -174,6 +220,9 @@ static void _sd_deinit()
 
 	if (sd_mounted)
 	{
+		// Write out any buffered data before the card goes away.
+		sd_trim_flush();
+		sd_cache_flush();
 		f_mount(NULL, "", 1);
 		sdmmc_storage_end(&sd_storage);
 		sd_mounted = false;
@@ -0,0 +1,116 @@
+/*
+ * OmniNX Installer - Sampling profiler (make PROFILE=1)
+ *
+ * TMR8 fires every PROFILE_PERIOD_US and the IRQ handler counts the address
+ * the BPMP was interrupted at. Addresses inside the engine's code go into one
+ * bin per word; anything else (the stub in IRAM, the bootrom) is kept as a raw
+ * sample. Busy loops waiting for the SD, SE or DMA show up as the polling
+ * function, which is exactly what we want to see.
+ *
+ * File: header of 8 u32 (magic, version, period in us, code start, bins,
+ * samples, raw samples kept, raw samples total), the bins, the raw samples.
+ * tools/profile_symbolize.py maps it to functions with the engine's .elf.
+ */
+
+#include "profile.h"
+
+#ifdef PROFILE
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
+#include <soc/irq.h>
+#include <soc/t210.h>
+#include <string.h>
+
+#define PROFILE_MAGIC     0x464F5250 // "PROF"
+#define PROFILE_VERSION   1
+#define PROFILE_PERIOD_US 250
+#define PROFILE_RAW_MAX   0x10000
+
+// Start and end of the engine's code, from the default PIE link script
+extern u8 __executable_start[], _etext[];
+extern void irq_enable_cpu_irq_exceptions(void);
+
+static u32 *prof_bins;
+static u32 prof_bin_count;
+static u32 *prof_raw;
+static u32 prof_samples;
+static u32 prof_raw_total;
+
+static int profile_irq(u32 irq, void *data) {
+    TMR(TIMER_TMR8_TMR_PCR) = TIMER_INTR_CLR;
+
+    u32 pc = irq_get_ret_addr() & ~1;
+    u32 off = pc - (u32)__executable_start;
+
+    if (off < prof_bin_count * 4) {
+        prof_bins[off / 4]++;
+    } else {
+        if (prof_raw_total < PROFILE_RAW_MAX)
+            prof_raw[prof_raw_total] = pc;
+        prof_raw_total++;
+    }
+    prof_samples++;
+
+    return IRQ_HANDLED;
+}
+
+bool profile_start(void) {
+    prof_bin_count = (_etext - __executable_start) / 4;
+    prof_bins = calloc(prof_bin_count, 4);
+    prof_raw = malloc(PROFILE_RAW_MAX * 4);
+    prof_samples = 0;
+    prof_raw_total = 0;
+
+    irq_setup_vectors();
+    if (!prof_bins || !prof_raw ||
+        irq_request(IRQ_TMR8, profile_irq, NULL, IRQ_FLAG_NONE) != IRQ_ENABLED) {
+        free(prof_bins);
+        free(prof_raw);
+        prof_bins = NULL;
+        prof_raw = NULL;
+        return false;
+    }
+
+    TMR(TIMER_TMR8_TMR_PCR) = TIMER_INTR_CLR;
+    TMR(TIMER_TMR8_TMR_PTV) = TIMER_EN | TIMER_PER_EN | (PROFILE_PERIOD_US - 1);
+    irq_enable_cpu_irq_exceptions();
+
+    return true;
+}
+
+int profile_stop(void) {
+    FIL fp;
+    UINT bw;
+
+    if (!prof_bins)
+        return FR_OK;
+
+    TMR(TIMER_TMR8_TMR_PTV) = 0;
+    TMR(TIMER_TMR8_TMR_PCR) = TIMER_INTR_CLR;
+    irq_end();
+
+    u32 raw = MIN(prof_raw_total, PROFILE_RAW_MAX);
+    u32 hdr[8] = {
+        PROFILE_MAGIC, PROFILE_VERSION, PROFILE_PERIOD_US, (u32)__executable_start,
+        prof_bin_count, prof_samples, raw, prof_raw_total
+    };
+
+    f_mkdir("sd:/config/omninx");
+    int res = f_open(&fp, PROFILE_PATH, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res == FR_OK) {
+        res = f_write(&fp, hdr, sizeof(hdr), &bw);
+        if (res == FR_OK)
+            res = f_write(&fp, prof_bins, prof_bin_count * 4, &bw);
+        if (res == FR_OK)
+            res = f_write(&fp, prof_raw, raw * 4, &bw);
+        f_close(&fp);
+    }
+
+    free(prof_bins);
+    free(prof_raw);
+    prof_bins = NULL;
+    prof_raw = NULL;
+
+    return res;
+}
+#endif
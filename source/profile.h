@@ -0,0 +1,14 @@
+/*
+ * OmniNX Installer - Sampling profiler (make PROFILE=1)
+ */
+
+#pragma once
+#include <utils/types.h>
+
+#define PROFILE_PATH "sd:/config/omninx/profile.bin"
+
+// Sample the interrupted PC on a periodic timer IRQ until profile_stop()
+bool profile_start(void);
+
+// Stop sampling and write the histogram to PROFILE_PATH
+int profile_stop(void);
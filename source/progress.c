@@ -0,0 +1,159 @@
+/*
+ * OmniNX Installer - Progress line with throughput and ETA
+ *
+ * Counting items made a 200 MB file weigh as much as a 1 KB one, so the
+ * percentage said nothing about the time left. Copies now report every chunk
+ * they write and deletes every file they remove. The line is redrawn on a
+ * fixed interval, not per item, so thousands of small files cost no more
+ * screen updates than one large one. MB/s and files/s are smoothed over the
+ * intervals and the remaining bytes (files for deletes) give the ETA.
+ */
+
+#include "progress.h"
+#include "gfx.h"
+#include <string.h>
+#include <utils/util.h>
+
+#define PROGRESS_INTERVAL_MS 250
+
+#undef COLOR_CYAN
+#undef COLOR_GREEN
+#undef COLOR_RED
+#undef COLOR_WHITE
+#define COLOR_CYAN    0xFF00FFFF
+#define COLOR_GREEN   0xFF00FF00
+#define COLOR_RED     0xFFFF0000
+#define COLOR_WHITE   0xFFFFFFFF
+
+typedef struct {
+    bool active;
+    bool by_files;   // Deletes: progress and ETA from files, not bytes
+    const char *verb;
+    const char *name;
+    u64 bytes_total;
+    u64 bytes_done;
+    u32 files_total;
+    u32 files_done;
+    u32 start_ms;
+    u32 last_ms;     // Last redraw
+    u64 last_bytes;
+    u32 last_files;
+    u32 bps;         // Smoothed bytes/s
+    u32 fps10;       // Smoothed files/s * 10
+    u32 x, y;        // Start of the line
+    u32 min_y;       // Furthest the line reached (y runs right to left)
+} progress_t;
+
+static progress_t prog;
+
+static const char *const progress_verbs[] = {
+    "Kopiere", "Sichere", "Wiederherst.", "Loesche", "Bereinige"
+};
+
+static void set_color(u32 color) {
+    gfx_con_setcol(color, gfx_con.fillbg, gfx_con.bgcol);
+}
+
+// Blank what a longer previous draw left behind
+static void progress_pad(void) {
+    while (gfx_con.y > prog.min_y)
+        gfx_putc(' ');
+    prog.min_y = gfx_con.y;
+}
+
+static void progress_draw(void) {
+    u32 pct;
+    u32 eta = 0;
+
+    if (prog.by_files || !prog.bytes_total) {
+        pct = prog.files_total ? (u32)((u64)prog.files_done * 100 / prog.files_total) : 0;
+        if (prog.fps10 && prog.files_total > prog.files_done)
+            eta = (prog.files_total - prog.files_done) * 10 / prog.fps10;
+    } else {
+        pct = (u32)(prog.bytes_done * 100 / prog.bytes_total);
+        if (prog.bps && prog.bytes_total > prog.bytes_done)
+            eta = (u32)((prog.bytes_total - prog.bytes_done) / prog.bps);
+    }
+    pct = MIN(pct, 100);
+
+    gfx_con_setpos(prog.x, prog.y);
+    set_color(COLOR_CYAN);
+    gfx_printf("  %s: %s [%3d%%]", prog.verb, prog.name, pct);
+    if (prog.by_files) {
+        gfx_printf(" %d/%d Dateien %d/s", prog.files_done, prog.files_total, prog.fps10 / 10);
+    } else {
+        u32 mbps10 = (u32)(((u64)prog.bps * 10) >> 20);
+        gfx_printf(" %d/%dMB %d.%dMB/s %dDat/s", (u32)(prog.bytes_done >> 20),
+            (u32)(prog.bytes_total >> 20), mbps10 / 10, mbps10 % 10, prog.fps10 / 10);
+    }
+    if (eta)
+        gfx_printf(" ETA %d:%02d", eta / 60, eta % 60);
+    progress_pad();
+    set_color(COLOR_WHITE);
+}
+
+static u32 progress_smooth(u32 avg, u32 sample) {
+    return avg ? (avg * 3 + sample) / 4 : sample;
+}
+
+void progress_begin(progress_kind_t kind, const char *name, u64 bytes, u32 files) {
+    memset(&prog, 0, sizeof(prog));
+    prog.active = true;
+    prog.by_files = kind == PROGRESS_DELETE || kind == PROGRESS_CLEANUP;
+    prog.verb = progress_verbs[kind];
+    prog.name = name;
+    prog.bytes_total = bytes;
+    prog.files_total = files;
+    prog.start_ms = get_tmr_ms();
+    prog.last_ms = prog.start_ms;
+
+    gfx_con_getpos(&prog.x, &prog.y);
+    prog.min_y = prog.y;
+    progress_draw();
+}
+
+void progress_add(u64 bytes, u32 files) {
+    if (!prog.active)
+        return;
+
+    prog.bytes_done += bytes;
+    prog.files_done += files;
+
+    u32 now = get_tmr_ms();
+    u32 dt = now - prog.last_ms;
+    if (dt < PROGRESS_INTERVAL_MS)
+        return;
+
+    prog.bps = progress_smooth(prog.bps, (u32)((prog.bytes_done - prog.last_bytes) * 1000 / dt));
+    prog.fps10 = progress_smooth(prog.fps10, (prog.files_done - prog.last_files) * 10000 / dt);
+    prog.last_ms = now;
+    prog.last_bytes = prog.bytes_done;
+    prog.last_files = prog.files_done;
+
+    progress_draw();
+}
+
+void progress_end(bool ok) {
+    if (!prog.active)
+        return;
+    prog.active = false;
+
+    u32 s = (get_tmr_ms() - prog.start_ms) / 1000;
+
+    gfx_con_setpos(prog.x, prog.y);
+    if (ok) {
+        set_color(COLOR_GREEN);
+        if (prog.by_files)
+            gfx_printf("  %s: %s [100%%] %d Dateien, %d:%02d - Fertig!", prog.verb, prog.name,
+                prog.files_done, s / 60, s % 60);
+        else
+            gfx_printf("  %s: %s [100%%] %d MB, %d Dateien, %d:%02d - Fertig!", prog.verb, prog.name,
+                (u32)(prog.bytes_done >> 20), prog.files_done, s / 60, s % 60);
+    } else {
+        set_color(COLOR_RED);
+        gfx_printf("  %s: %s - Fehlgeschlagen!", prog.verb, prog.name);
+    }
+    progress_pad();
+    gfx_printf("\n");
+    set_color(COLOR_WHITE);
+}
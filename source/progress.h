@@ -0,0 +1,25 @@
+/*
+ * OmniNX Installer - Progress line with throughput and ETA
+ */
+
+#pragma once
+#include <utils/types.h>
+
+typedef enum {
+    PROGRESS_COPY,
+    PROGRESS_BACKUP,
+    PROGRESS_RESTORE,
+    PROGRESS_DELETE,
+    PROGRESS_CLEANUP
+} progress_kind_t;
+
+// Start a progress line at the cursor, e.g. "Kopiere: atmosphere/", with the
+// planned bytes and files. Copies go by bytes, deletes by files.
+void progress_begin(progress_kind_t kind, const char *name, u64 bytes, u32 files);
+
+// Work done since the last call. Called by the copy and delete code for every
+// chunk and file, redraws at most every PROGRESS_INTERVAL_MS.
+void progress_add(u64 bytes, u32 files);
+
+// Replace the line with the result and move to the next line
+void progress_end(bool ok);
@@ -0,0 +1,100 @@
+/*
+ * OmniNX Installer - SD card I/O profile
+ *
+ * Maps what the card reports about itself to the I/O parameters used by the
+ * copy loop and the diskio write shaping. Old class 2-6 cards have small AUs
+ * and choke on anything but AU-sized sequential writes, so they get smaller
+ * chunks and fewer metadata syncs. U3/A1 cards take large transfers, and A2
+ * cards carry a write cache that makes small metadata writes cheap.
+ */
+
+#include "sd_profile.h"
+#include "nx_sd.h"
+#include <libs/fatfs/diskio.h>
+#include <mem/heap.h>
+#include <storage/sd.h>
+#include <storage/sdmmc.h>
+#include <utils/util.h>
+
+#define BENCH_SEQ_SECTORS   0x2000  // 4MB sequential read
+#define BENCH_RND_READS     16      // 4KB random reads
+#define BENCH_FAST_KBPS     60000   // Sequential read a U3 card reaches at SDR104
+#define BENCH_STD_KBPS      20000
+#define BENCH_FAST_RND_US   500     // Average 4KB random read latency of A1 cards
+
+static const sd_profile_t profiles[SD_TIER_COUNT] = {
+    //                   name        copy buf  shape   min  cache  log sync
+    [SD_TIER_LEGACY]   = { "Legacy",   0x100000, 0x2000, 8,   false, 16 },
+    [SD_TIER_STANDARD] = { "Standard", 0x400000, 0x4000, 8,   true,  8  },
+    [SD_TIER_FAST]     = { "Fast",     0x800000, 0x4000, 8,   true,  4  },
+    [SD_TIER_A2]       = { "A2",       0x800000, 0x4000, 4,   true,  1  },
+};
+
+static sd_tier_t tier = SD_TIER_LEGACY;
+
+// Read-only, so it is safe on any card. Returns the sequential read speed in KB/s.
+static u32 profile_bench(u32 *rnd_us) {
+    *rnd_us = 0;
+
+    u8 *buf = malloc(BENCH_SEQ_SECTORS * 512);
+    if (!buf)
+        return 0;
+
+    u32 sector = ALIGN_DOWN(sd_storage.sec_cnt / 2, BENCH_SEQ_SECTORS);
+    u32 start = get_tmr_us();
+    bool ok = sdmmc_storage_read(&sd_storage, sector, BENCH_SEQ_SECTORS, buf);
+    u32 elapsed = get_tmr_us() - start;
+
+    // Scattered 4KB reads across the card.
+    u32 step = sd_storage.sec_cnt / BENCH_RND_READS;
+    start = get_tmr_us();
+    for (u32 i = 0; ok && i < BENCH_RND_READS; i++)
+        ok = sdmmc_storage_read(&sd_storage, ALIGN_DOWN(i * step + (step >> 1), 8), 8, buf);
+    *rnd_us = (get_tmr_us() - start) / BENCH_RND_READS;
+
+    free(buf);
+
+    if (!ok || !elapsed)
+        return 0;
+
+    return (u32)((u64)(BENCH_SEQ_SECTORS / 2) * 1000000 / elapsed);
+}
+
+void sd_profile_init(void) {
+    sd_ssr_t *ssr = &sd_storage.ssr;
+
+    if (!sd_storage.has_sector_access || sd_storage.scr.sda_vsn < SCR_SPEC_VER_2)
+        tier = SD_TIER_LEGACY;
+    else if (ssr->app_class >= 2)
+        tier = SD_TIER_A2;
+    else if (ssr->app_class == 1 || ssr->uhs_grade >= 3 || ssr->video_class >= 30)
+        tier = SD_TIER_FAST;
+    else if (ssr->speed_class >= 10 || ssr->uhs_grade)
+        tier = SD_TIER_STANDARD;
+    else if (ssr->speed_class)
+        tier = SD_TIER_LEGACY;
+    else {
+        // No class reported (fakes, some OEM cards). Measure instead.
+        u32 rnd_us;
+        u32 kbps = profile_bench(&rnd_us);
+
+        if (kbps >= BENCH_FAST_KBPS && rnd_us && rnd_us <= BENCH_FAST_RND_US)
+            tier = SD_TIER_FAST;
+        else if (kbps >= BENCH_STD_KBPS)
+            tier = SD_TIER_STANDARD;
+        else
+            tier = SD_TIER_LEGACY;
+    }
+
+    // Hand the write shaping parameters to the disk layer
+    DWORD shape[2] = { profiles[tier].shape_sectors, profiles[tier].shape_min_sectors };
+    disk_ioctl(DRIVE_SD, CTRL_SET_SHAPING, shape);
+}
+
+const sd_profile_t *sd_profile_get(void) {
+    return &profiles[tier];
+}
+
+sd_tier_t sd_profile_tier(void) {
+    return tier;
+}
@@ -0,0 +1,31 @@
+/*
+ * OmniNX Installer - SD card I/O profile
+ */
+
+#pragma once
+#include <utils/types.h>
+
+typedef enum {
+    SD_TIER_LEGACY = 0,   // SDSC, SD 1.x or speed class 2-6
+    SD_TIER_STANDARD,     // Class 10 / U1
+    SD_TIER_FAST,         // U3, V30+ or A1
+    SD_TIER_A2,           // A2: internal cache and command queue
+    SD_TIER_COUNT
+} sd_tier_t;
+
+typedef struct {
+    const char *name;
+    u32  copy_buf_size;     // file_copy() transfer size in bytes
+    u32  shape_sectors;     // Write shaping flush granularity (capped by the AU)
+    u32  shape_min_sectors; // Out-of-run writes below this bypass the write buffer
+    bool use_cache;         // Enable the card write cache if present
+    u32  log_sync_lines;    // Log lines between f_sync() calls
+} sd_profile_t;
+
+// Pick the profile for the mounted card from CID/CSD/SCR/SSR. When the registers
+// don't tell much (no speed/UHS/app class), a short read-only benchmark decides.
+void sd_profile_init(void);
+
+// Active profile (conservative defaults before sd_profile_init())
+const sd_profile_t *sd_profile_get(void);
+sd_tier_t sd_profile_tier(void);
@@ -0,0 +1,161 @@
+/*
+ * OmniNX Installer - Persisted SD card bus mode and tuning history
+ *
+ * Each boot brings the SD card up at the fastest mode and only walks down
+ * sd_init_retry()'s speed ladder after transfers start failing. Marginal cards
+ * pay for that on every run. This keeps a small per-card record, keyed by the
+ * raw CID, of the last mode that finished a session cleanly, the modes that
+ * failed and the tap value the tuning settled on. The file lives on the card
+ * itself, so it can only be consulted after the first mount; a card with a
+ * known-bad mode is remounted at its proven mode before any bulk I/O starts.
+ */
+
+#include "sd_tuning.h"
+#include "nx_sd.h"
+#include <libs/fatfs/ff.h>
+#include <storage/sdmmc.h>
+#include <string.h>
+
+#define SD_TUNING_DIR     "sd:/config/omninx"
+#define SD_TUNING_PATH    "sd:/config/omninx/sd_tuning.bin"
+#define SD_TUNING_MAGIC   0x544E4453 // "SDNT"
+#define SD_TUNING_VERSION 1
+#define SD_TUNING_ENTRIES 8
+
+// Clean sessions at a lowered mode before the faster modes are probed again
+#define SD_TUNING_REPROBE_SESSIONS 8
+
+typedef struct {
+    u8  cid[16];
+    u8  good_mode;    // Last mode that completed a session without R/W failures
+    u8  bad_modes;    // BIT(mode) for every mode that failed on this card
+    u8  tap;          // Tap value after tuning at good_mode
+    u8  clean_runs;   // Consecutive clean sessions at good_mode
+    u16 init_fails;   // Accumulated error history
+    u16 rw_fails;
+    u16 rw_retries;
+    u16 sessions;
+    u32 stamp;        // Session counter value of the last use (for replacement)
+} sd_tuning_entry_t;
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 rsvd;
+    u32 stamp;
+    sd_tuning_entry_t entries[SD_TUNING_ENTRIES];
+} sd_tuning_file_t;
+
+static sd_tuning_file_t tuning;
+static bool tuning_loaded = false;
+
+static void tuning_load(void) {
+    FIL fp;
+    UINT br = 0;
+
+    if (tuning_loaded)
+        return;
+    tuning_loaded = true;
+
+    if (f_open(&fp, SD_TUNING_PATH, FA_READ) == FR_OK) {
+        f_read(&fp, &tuning, sizeof(tuning), &br);
+        f_close(&fp);
+    }
+
+    if (br != sizeof(tuning) || tuning.magic != SD_TUNING_MAGIC || tuning.version != SD_TUNING_VERSION) {
+        memset(&tuning, 0, sizeof(tuning));
+        tuning.magic = SD_TUNING_MAGIC;
+        tuning.version = SD_TUNING_VERSION;
+    }
+}
+
+// Find the entry of the inserted card, optionally replacing the least recently used one
+static sd_tuning_entry_t *tuning_find(bool create) {
+    sd_tuning_entry_t *oldest = &tuning.entries[0];
+
+    for (u32 i = 0; i < SD_TUNING_ENTRIES; i++) {
+        sd_tuning_entry_t *e = &tuning.entries[i];
+        if (e->sessions && !memcmp(e->cid, sd_storage.raw_cid, sizeof(e->cid)))
+            return e;
+        if (e->stamp < oldest->stamp)
+            oldest = e;
+    }
+
+    if (!create)
+        return NULL;
+
+    memset(oldest, 0, sizeof(*oldest));
+    memcpy(oldest->cid, sd_storage.raw_cid, sizeof(oldest->cid));
+    oldest->good_mode = SD_UHS_SDR82;
+
+    return oldest;
+}
+
+bool sd_tuning_apply(void) {
+    tuning_load();
+
+    sd_tuning_entry_t *e = tuning_find(false);
+    if (!e || !e->bad_modes)
+        return true;
+
+    u32 mode = sd_get_mode();
+
+    // The current mode worked before or is being probed again, just avoid the bad ones on fallback
+    if (!(e->bad_modes & BIT(mode)) || e->good_mode >= mode || e->good_mode == SD_INIT_FAIL) {
+        sd_set_mode(mode, e->bad_modes);
+        return true;
+    }
+
+    // Known to fail at this mode. Remount at the proven one before any bulk I/O.
+    sd_unmount();
+    sd_set_mode(e->good_mode, e->bad_modes);
+
+    return sd_mount();
+}
+
+void sd_tuning_save(void) {
+    u32 mode = sd_get_mode();
+
+    if (mode == SD_INIT_FAIL)
+        return;
+
+    tuning_load();
+
+    sd_tuning_entry_t *e = tuning_find(true);
+    u16 *errors = sd_get_error_count();
+
+    e->init_fails += errors[SD_ERROR_INIT_FAIL];
+    e->rw_fails   += errors[SD_ERROR_RW_FAIL];
+    e->rw_retries += errors[SD_ERROR_RW_RETRY];
+    e->sessions++;
+    e->stamp = ++tuning.stamp;
+
+    if (errors[SD_ERROR_INIT_FAIL] || errors[SD_ERROR_RW_FAIL]) {
+        // Every mode above the one we ended up at has failed during this session
+        for (u32 m = mode + 1; m <= SD_UHS_SDR82; m++)
+            e->bad_modes |= BIT(m);
+        e->clean_runs = 0;
+    } else if (e->good_mode == mode) {
+        // Give the faster modes another chance after enough clean sessions
+        if (++e->clean_runs >= SD_TUNING_REPROBE_SESSIONS) {
+            e->bad_modes = 0;
+            e->clean_runs = 0;
+        }
+    } else {
+        e->clean_runs = 1;
+    }
+
+    e->bad_modes &= ~BIT(mode);
+    e->good_mode = mode;
+
+    sdmmc_save_tap_value(&sd_sdmmc);
+    e->tap = sd_sdmmc.venclkctl_tap;
+
+    FIL fp;
+    UINT bw;
+    f_mkdir(SD_TUNING_DIR);
+    if (f_open(&fp, SD_TUNING_PATH, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK) {
+        f_write(&fp, &tuning, sizeof(tuning), &bw);
+        f_close(&fp);
+    }
+}
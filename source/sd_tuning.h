@@ -0,0 +1,14 @@
+/*
+ * OmniNX Installer - Persisted SD card bus mode and tuning history
+ */
+
+#pragma once
+#include <utils/types.h>
+
+// Load the history of the inserted card and, if its current bus mode is known
+// to be unstable, remount it directly at the last known-good mode.
+// Returns false if the card could not be remounted.
+bool sd_tuning_apply(void);
+
+// Record the mode, tap value and error counters of this session
+void sd_tuning_save(void);
@@ -0,0 +1,434 @@
+/*
+ * OmniNX Installer - SHA-256 verification of installed files
+ *
+ * The CRC32 of the inventory only tells whether a file changed. To know that
+ * what lands on the card is what the pack shipped, every chunk that is copied
+ * is also handed to the Security Engine while it is still in the copy buffer.
+ * The SE reads it with its own DMA while the SD controller writes it out, so
+ * the hash costs next to no time. The digest is then checked against the
+ * sha256.txt of the pack, when there is one.
+ *
+ * The SE hashes in 64 byte blocks and only the last piece of a message may be
+ * shorter. Chunks that don't end on a block (e.g. from the ZIP decoder) keep
+ * their tail in a small buffer until the next chunk completes it.
+ *
+ * Built with VERIFY_READBACK=1, each file is also read back from the card and
+ * hashed once more, which catches cards that drop writes.
+ */
+
+#include "verify.h"
+#include "fs.h"
+#include "inventory.h"
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
+#include <sec/se.h>
+#include <sec/se_t210.h>
+#include <string.h>
+#include <utils/util.h>
+
+#define SHA_BLOCK     64
+#define SHA_CHUNK_MAX 0xFFFFC0 // SE limit is 16MB - 1, kept on a block
+#define READBACK_SIZE 0x80000  // Per buffer, two are used
+
+typedef struct {
+    u32 hash;   // inventory_path_hash() of the destination
+    char *path; // In list_paths, compared on a hash hit
+    u8 digest[VERIFY_DIGEST_SIZE];
+} verify_entry_t;
+
+static verify_entry_t *list_ents;
+static char *list_paths;
+static u32 list_count;
+static u8 *sha_carry;
+static u32 verify_ok, verify_bad, verify_unlisted;
+
+static const u8 sha256_empty[VERIFY_DIGEST_SIZE] = {
+    0xE3, 0xB0, 0xC4, 0x42, 0x98, 0xFC, 0x1C, 0x14, 0x9A, 0xFB, 0xF4, 0xC8, 0x99, 0x6F, 0xB9, 0x24,
+    0x27, 0xAE, 0x41, 0xE4, 0x64, 0x9B, 0x93, 0x4C, 0xA4, 0x95, 0x99, 0x1B, 0x78, 0x52, 0xB8, 0x55
+};
+
+static int hex_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void verify_sift_down(verify_entry_t *ents, u32 root, u32 count) {
+    while (root * 2 + 1 < count) {
+        u32 child = root * 2 + 1;
+        if (child + 1 < count && ents[child + 1].hash > ents[child].hash)
+            child++;
+        if (ents[root].hash >= ents[child].hash)
+            return;
+
+        verify_entry_t tmp = ents[root];
+        ents[root] = ents[child];
+        ents[child] = tmp;
+        root = child;
+    }
+}
+
+static void verify_sort(verify_entry_t *ents, u32 count) {
+    if (count < 2)
+        return;
+
+    for (u32 i = count / 2; i-- > 0;)
+        verify_sift_down(ents, i, count);
+
+    for (u32 end = count - 1; end > 0; end--) {
+        verify_entry_t tmp = ents[0];
+        ents[0] = ents[end];
+        ents[end] = tmp;
+        verify_sift_down(ents, 0, end);
+    }
+}
+
+// Same rules as inventory_path_hash(): no "sd:", "//" is "/", any case
+static bool verify_path_eq(const char *a, const char *b) {
+    if (!strncmp(a, "sd:", 3))
+        a += 3;
+    if (!strncmp(b, "sd:", 3))
+        b += 3;
+
+    for (;;) {
+        if (a[0] == '/' && a[1] == '/') {
+            a++;
+            continue;
+        }
+        if (b[0] == '/' && b[1] == '/') {
+            b++;
+            continue;
+        }
+
+        char ca = *a >= 'A' && *a <= 'Z' ? *a + 'a' - 'A' : *a;
+        char cb = *b >= 'A' && *b <= 'Z' ? *b + 'a' - 'A' : *b;
+        if (ca != cb)
+            return false;
+        if (!ca)
+            return true;
+        a++;
+        b++;
+    }
+}
+
+static verify_entry_t *verify_find(const char *path) {
+    u32 hash = inventory_path_hash(path);
+    u32 lo = 0;
+    u32 hi = list_count;
+
+    // First entry with this hash, then the one that really is this path
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if (list_ents[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < list_count && list_ents[lo].hash == hash; lo++) {
+        if (verify_path_eq(list_ents[lo].path, path))
+            return &list_ents[lo];
+    }
+
+    return NULL;
+}
+
+u32 verify_load_list(char *text, u32 size) {
+    u32 lines = 1;
+
+    verify_free();
+
+    for (u32 i = 0; i < size; i++) {
+        if (text[i] == '\n')
+            lines++;
+    }
+
+    // Paths get a leading '/' and a NUL, at most two bytes more per line
+    list_ents = malloc(lines * sizeof(verify_entry_t));
+    list_paths = malloc(size + lines * 2);
+    if (!list_ents || !list_paths) {
+        verify_free();
+        return 0;
+    }
+
+    char *path = list_paths;
+
+    char *end = text + size;
+    for (char *line = text; line < end;) {
+        char *next = line;
+        while (next < end && *next != '\n')
+            next++;
+        char *eol = next;
+        if (eol > line && eol[-1] == '\r')
+            eol--;
+        if (next < end)
+            next++;
+
+        // Digest, white space, an optional '*' (binary mode) and the path
+        verify_entry_t *e = &list_ents[list_count];
+        u32 i = 0;
+        for (; i < VERIFY_DIGEST_SIZE * 2 && line + i < eol; i++) {
+            int v = hex_val(line[i]);
+            if (v < 0)
+                break;
+            if (i & 1)
+                e->digest[i / 2] |= v;
+            else
+                e->digest[i / 2] = v << 4;
+        }
+
+        char *name = line + i;
+        if (i == VERIFY_DIGEST_SIZE * 2 && name < eol && (*name == ' ' || *name == '\t')) {
+            while (name < eol && (*name == ' ' || *name == '\t'))
+                name++;
+            if (name < eol && *name == '*')
+                name++;
+            if (eol - name > 2 && name[0] == '.' && name[1] == '/')
+                name += 2;
+
+            u32 len = eol - name;
+            if (len) {
+                path[0] = '/';
+                for (u32 j = 0; j < len; j++)
+                    path[j + 1] = name[j] == '\\' ? '/' : name[j];
+                path[len + 1] = 0;
+                e->hash = inventory_path_hash(path);
+                e->path = path;
+                path += len + 2;
+                list_count++;
+            }
+        }
+
+        line = next;
+    }
+
+    verify_sort(list_ents, list_count);
+    log_write("VERIFY: %d hashes loaded\n", list_count);
+
+    return list_count;
+}
+
+u32 verify_load_file(const char *path) {
+    FIL fp;
+    UINT br;
+
+    if (f_open(&fp, path, FA_READ) != FR_OK)
+        return 0;
+
+    u32 size = f_size(&fp);
+    char *text = malloc(size + 1);
+    if (!text) {
+        f_close(&fp);
+        return 0;
+    }
+
+    int res = f_read(&fp, text, size, &br);
+    f_close(&fp);
+
+    u32 count = 0;
+    if (res == FR_OK && br == size)
+        count = verify_load_list(text, size);
+    free(text);
+
+    return count;
+}
+
+void verify_free(void) {
+    free(list_ents);
+    free(list_paths);
+    list_ents = NULL;
+    list_paths = NULL;
+    list_count = 0;
+    verify_ok = 0;
+    verify_bad = 0;
+    verify_unlisted = 0;
+}
+
+bool verify_enabled(void) {
+#ifdef VERIFY_READBACK
+    return true;
+#else
+    return list_count != 0;
+#endif
+}
+
+// Hash size bytes at src, in the background unless oneshot
+static void verify_run(verify_sha_t *s, const void *src, u32 size, bool oneshot) {
+    u32 cfg = s->started ? SHA_CONTINUE : SHA_INIT_HASH;
+
+    if (!se_calc_sha256(s->hash, s->msg_left, src, size, s->total, cfg, oneshot))
+        s->failed = true;
+
+    s->started = true;
+    s->pending = !oneshot;
+    s->fed += size;
+}
+
+void verify_begin(verify_sha_t *s, u64 total) {
+    memset(s, 0, sizeof(*s));
+
+    if (!verify_enabled())
+        return;
+
+    // The SE reads it by DMA, keep it on the heap
+    if (!sha_carry)
+        sha_carry = malloc(SHA_BLOCK);
+
+    s->total = total;
+    s->active = sha_carry != NULL;
+}
+
+void verify_wait(verify_sha_t *s) {
+    if (!s->pending)
+        return;
+
+    if (!se_calc_sha256_finalize(s->hash, s->msg_left))
+        s->failed = true;
+    s->pending = false;
+}
+
+void verify_update(verify_sha_t *s, const void *buf, u32 size) {
+    const u8 *p = buf;
+
+    if (!s->active || !size)
+        return;
+
+    verify_wait(s);
+
+    // Complete the block left over from the previous chunk
+    if (s->carry_len) {
+        u32 take = MIN(size, SHA_BLOCK - s->carry_len);
+        memcpy(sha_carry + s->carry_len, p, take);
+        s->carry_len += take;
+        p += take;
+        size -= take;
+
+        if (s->carry_len < SHA_BLOCK)
+            return;
+        verify_run(s, sha_carry, SHA_BLOCK, true);
+        s->carry_len = 0;
+    }
+
+    // The end of the file may be hashed as it is, otherwise only whole blocks
+    u32 len = size;
+    if (s->fed + size != s->total)
+        len = ALIGN_DOWN(size, SHA_BLOCK);
+
+    while (len) {
+        u32 n = MIN(len, SHA_CHUNK_MAX);
+        verify_run(s, p, n, n == len ? false : true);
+        p += n;
+        size -= n;
+        len -= n;
+    }
+
+    if (size) {
+        memcpy(sha_carry, p, size);
+        s->carry_len = size;
+    }
+}
+
+// Final digest of a completely fed stream
+static bool verify_final(verify_sha_t *s, u8 *digest) {
+    verify_wait(s);
+
+    if (s->carry_len) {
+        verify_run(s, sha_carry, s->carry_len, true);
+        s->carry_len = 0;
+    }
+
+    if (!s->total)
+        memcpy(digest, sha256_empty, VERIFY_DIGEST_SIZE);
+    else
+        memcpy(digest, s->hash, VERIFY_DIGEST_SIZE);
+
+    return !s->failed && s->fed == s->total;
+}
+
+#ifdef VERIFY_READBACK
+// Hash the file on the card, reading one buffer while the SE hashes the other
+static int verify_readback(const char *dst, u64 size, u8 *digest) {
+    verify_sha_t s;
+    FIL fp;
+    UINT br;
+
+    int res = f_open(&fp, dst, FA_READ | FA_OPEN_EXISTING);
+    if (res != FR_OK)
+        return res;
+
+    u8 *buf = malloc(READBACK_SIZE * 2);
+    if (!buf) {
+        f_close(&fp);
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    verify_begin(&s, size);
+    for (u32 i = 0; ; i ^= 1) {
+        u8 *cur = buf + i * READBACK_SIZE;
+        res = f_read(&fp, cur, READBACK_SIZE, &br);
+        if (res != FR_OK || !br)
+            break;
+        verify_update(&s, cur, br);
+    }
+
+    if (!verify_final(&s, digest) && res == FR_OK)
+        res = FR_INT_ERR;
+
+    free(buf);
+    f_close(&fp);
+
+    return res;
+}
+#endif
+
+int verify_end(verify_sha_t *s, const char *dst) {
+    u8 digest[VERIFY_DIGEST_SIZE];
+
+    if (!s->active)
+        return FR_OK;
+    s->active = false;
+
+    // Verify was asked for, a file it couldn't hash isn't verified
+    if (!verify_final(s, digest)) {
+        log_write("  ERROR: SHA-256 not computed\n");
+        verify_bad++;
+        return FR_INT_ERR;
+    }
+
+    bool checked = false;
+    if (list_count) {
+        verify_entry_t *e = verify_find(dst);
+        if (!e) {
+            verify_unlisted++;
+        } else if (memcmp(e->digest, digest, VERIFY_DIGEST_SIZE)) {
+            log_write("  ERROR: SHA-256 does not match the pack\n");
+            verify_bad++;
+            return FR_INT_ERR;
+        } else {
+            checked = true;
+        }
+    }
+
+#ifdef VERIFY_READBACK
+    u8 card[VERIFY_DIGEST_SIZE];
+    int res = verify_readback(dst, s->total, card);
+    if (res != FR_OK || memcmp(card, digest, VERIFY_DIGEST_SIZE)) {
+        log_write("  ERROR: read back %s\n", res != FR_OK ? fs_error_str(res) : "differs");
+        verify_bad++;
+        return FR_INT_ERR;
+    }
+    checked = true;
+#endif
+
+    if (checked)
+        verify_ok++;
+
+    return FR_OK;
+}
+
+void verify_counts(u32 *ok, u32 *bad, u32 *unlisted) {
+    *ok = verify_ok;
+    *bad = verify_bad;
+    *unlisted = verify_unlisted;
+}
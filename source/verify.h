@@ -0,0 +1,48 @@
+/*
+ * OmniNX Installer - SHA-256 verification of installed files
+ */
+
+#pragma once
+#include <utils/types.h>
+
+#define VERIFY_LIST_NAME "sha256.txt" // Hash list in the pack folder
+#define VERIFY_DIGEST_SIZE 32
+
+// Hash of one file, computed by the Security Engine while it is copied
+typedef struct {
+    u32 hash[VERIFY_DIGEST_SIZE / 4]; // Intermediate state between chunks
+    u32 msg_left[2];
+    u64 total;     // File size
+    u64 fed;       // Bytes handed to the SE so far
+    u32 carry_len; // Bytes waiting in the partial block buffer
+    bool active;
+    bool started;
+    bool pending;  // An SE operation is running in the background
+    bool failed;
+} verify_sha_t;
+
+// Load a sha256sum style list: "<64 hex digits>  <path below the pack folder>"
+// per line. text is modified. Returns the number of entries.
+u32 verify_load_list(char *text, u32 size);
+u32 verify_load_file(const char *path);
+void verify_free(void);
+
+// Files are hashed when there is a list or read-back verify is built in
+bool verify_enabled(void);
+
+// Start hashing a file of total bytes (does nothing if verify is off)
+void verify_begin(verify_sha_t *s, u64 total);
+
+// Hand the next chunk to the SE. The last whole blocks of it are hashed in the
+// background: write the chunk out, then call verify_wait() before the buffer
+// is reused.
+void verify_update(verify_sha_t *s, const void *buf, u32 size);
+void verify_wait(verify_sha_t *s);
+
+// Finish the hash of the file written to dst, check it against the list and,
+// with VERIFY_READBACK, against the file read back from the card.
+// Returns FR_OK, or FR_INT_ERR on a mismatch or when the SE could not hash it.
+int verify_end(verify_sha_t *s, const char *dst);
+
+// Files that matched, did not match, and were not in the list
+void verify_counts(u32 *ok, u32 *bad, u32 *unlisted);
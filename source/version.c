@@ -3,6 +3,7 @@
  */
 
 #include "version.h"
+#include "zip.h"
 #include <libs/fatfs/ff.h>
 #include <string.h>
 #include <utils/sprintf.h>
@@ -153,7 +154,11 @@ omninx_variant_t detect_pack_variant(void) {
         return VARIANT_OC;
     }
     
-    return VARIANT_NONE;
+    // Release ZIP copied to the card as is
+    omninx_variant_t variant = VARIANT_NONE;
+    zip_find(&variant);
+    
+    return variant;
 }
 
 // Get human-readable variant name
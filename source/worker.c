@@ -0,0 +1,226 @@
+/*
+ * OmniNX Installer - Cortex-A57 worker
+ *
+ * The installer runs on the BPMP, the A57 cluster is idle. CPU0 is booted into
+ * a small AArch64 loop that takes jobs from a ring in DRAM (worker_ring.c)
+ * and computes CRC32s with the ARMv8 CRC instructions. The BPMP queues the
+ * CRC of a buffer and writes the same buffer out meanwhile, so checksums no
+ * longer cost BPMP time. There is no AArch64 toolchain in the build, the loop
+ * is hand encoded like the SMMU payload of the BDK; worker_a57.S is its
+ * listing and tools/worker_code.py checks that both match.
+ *
+ * The worker turns its MMU on with an identity map: DRAM as normal
+ * non-cacheable memory (so loads can be pipelined and need no alignment), the
+ * rest as device memory. Its caches stay off, nothing needs to be cleaned on
+ * that side. The BPMP cache is write-through; it is invalidated before results
+ * are read.
+ *
+ * If the worker doesn't answer in time it is dropped and the BPMP does the
+ * work itself, as before.
+ */
+
+#include "worker.h"
+#include "worker_ring.h"
+#include "fs.h"
+#include <mem/heap.h>
+#include <soc/bpmp.h>
+#include <soc/ccplex.h>
+#include <soc/clock.h>
+#include <soc/t210.h>
+#include <string.h>
+#include <utils/util.h>
+
+#define WORKER_BOOT_MS   200
+#define WORKER_JOB_MS    1000
+#define WORKER_CRC_MIN   SZ_16K  // Smaller buffers are quicker on the BPMP
+
+#define PTE_BLOCK  (1 << 0)
+#define PTE_ATTR(x) ((x) << 2)   // MAIR index: 0 device, 1 normal NC
+#define PTE_AF     (1 << 10)
+#define PTE_XN     (1ULL << 54)
+
+static const u8 worker_code[] __attribute__((aligned(16))) = {
+	0x03, 0x00, 0x00, 0x14, // 0x000: B    start
+	0x00, 0x00, 0x00, 0x00, // 0x004: ring: .word 0 (Patched in by worker_start())
+	0x00, 0x00, 0x00, 0x00, // 0x008: ttbr: .word 0 (Patched in by worker_start())
+	0xE0, 0xFF, 0xFF, 0x18, // 0x00C: start: LDR  W0, ttbr
+	0x00, 0x20, 0x1E, 0xD5, // 0x010: MSR  TTBR0_EL3, X0
+	0x00, 0x80, 0x88, 0xD2, // 0x014: MOV  X0, #0x4400
+	0x00, 0xA2, 0x1E, 0xD5, // 0x018: MSR  MAIR_EL3, X0
+	0x00, 0x04, 0x80, 0x52, // 0x01C: MOV  W0, #0x20
+	0x00, 0x10, 0xB0, 0x72, // 0x020: MOVK W0, #0x8080, LSL #16
+	0x40, 0x20, 0x1E, 0xD5, // 0x024: MSR  TCR_EL3, X0
+	0xDF, 0x3F, 0x03, 0xD5, // 0x028: ISB
+	0x1F, 0x87, 0x0E, 0xD5, // 0x02C: TLBI ALLE3
+	0x9F, 0x3F, 0x03, 0xD5, // 0x030: DSB  SY
+	0x20, 0x06, 0x81, 0x52, // 0x034: MOV  W0, #0x831
+	0xA0, 0x18, 0xA6, 0x72, // 0x038: MOVK W0, #0x30C5, LSL #16
+	0x00, 0x10, 0x1E, 0xD5, // 0x03C: MSR  SCTLR_EL3, X0
+	0xDF, 0x3F, 0x03, 0xD5, // 0x040: ISB
+	0x13, 0xFE, 0xFF, 0x18, // 0x044: LDR  W19, ring
+	0x14, 0x00, 0x80, 0x52, // 0x048: MOV  W20, #0 (Jobs done)
+	0x61, 0x02, 0x40, 0xB9, // 0x04C: wait: LDR  W1, [X19] (head)
+	0x3F, 0x00, 0x14, 0x6B, // 0x050: CMP  W1, W20
+	0x61, 0x00, 0x00, 0x54, // 0x054: B.NE job
+	0x3F, 0x20, 0x03, 0xD5, // 0x058: YIELD
+	0xFC, 0xFF, 0xFF, 0x17, // 0x05C: B    wait
+	0xBF, 0x3F, 0x03, 0xD5, // 0x060: job: DMB  SY
+	0x82, 0x0E, 0x00, 0x12, // 0x064: AND  W2, W20, #0xF (WORKER_RING_JOBS - 1)
+	0x63, 0x02, 0x02, 0x91, // 0x068: ADD  X3, X19, #128
+	0x63, 0x14, 0x02, 0x8B, // 0x06C: ADD  X3, X3, X2, LSL #5
+	0x64, 0x14, 0x40, 0x29, // 0x070: LDP  W4, W5, [X3] (op, dst)
+	0x66, 0x1C, 0x41, 0x29, // 0x074: LDP  W6, W7, [X3, #8] (src, size)
+	0x68, 0x10, 0x40, 0xB9, // 0x078: LDR  W8, [X3, #16] (arg)
+	0x9F, 0x04, 0x00, 0x71, // 0x07C: CMP  W4, #1 (WORKER_OP_CRC32)
+	0x80, 0x00, 0x00, 0x54, // 0x080: B.EQ crc32
+	0x9F, 0x08, 0x00, 0x71, // 0x084: CMP  W4, #2 (WORKER_OP_STOP)
+	0x60, 0x03, 0x00, 0x54, // 0x088: B.EQ stop
+	0x16, 0x00, 0x00, 0x14, // 0x08C: B    done
+	0xE8, 0x03, 0x28, 0x2A, // 0x090: crc32: MVN  W8, W8
+	0xDF, 0x08, 0x40, 0xF2, // 0x094: crc32_align: TST  X6, #0x7
+	0xC0, 0x00, 0x00, 0x54, // 0x098: B.EQ crc32_8
+	0x07, 0x02, 0x00, 0xB4, // 0x09C: CBZ  X7, crc32_end
+	0xC9, 0x14, 0x40, 0x38, // 0x0A0: LDRB W9, [X6], #1
+	0x08, 0x41, 0xC9, 0x1A, // 0x0A4: CRC32B W8, W8, W9
+	0xE7, 0x04, 0x00, 0xD1, // 0x0A8: SUB  X7, X7, #1
+	0xFA, 0xFF, 0xFF, 0x17, // 0x0AC: B    crc32_align
+	0xFF, 0x20, 0x00, 0xF1, // 0x0B0: crc32_8: CMP  X7, #8
+	0xA3, 0x00, 0x00, 0x54, // 0x0B4: B.LO crc32_1
+	0xC9, 0x84, 0x40, 0xF8, // 0x0B8: LDR  X9, [X6], #8
+	0x08, 0x4D, 0xC9, 0x9A, // 0x0BC: CRC32X W8, W8, X9
+	0xE7, 0x20, 0x00, 0xD1, // 0x0C0: SUB  X7, X7, #8
+	0xFB, 0xFF, 0xFF, 0x17, // 0x0C4: B    crc32_8
+	0xA7, 0x00, 0x00, 0xB4, // 0x0C8: crc32_1: CBZ  X7, crc32_end
+	0xC9, 0x14, 0x40, 0x38, // 0x0CC: LDRB W9, [X6], #1
+	0x08, 0x41, 0xC9, 0x1A, // 0x0D0: CRC32B W8, W8, W9
+	0xE7, 0x04, 0x00, 0xD1, // 0x0D4: SUB  X7, X7, #1
+	0xFC, 0xFF, 0xFF, 0x17, // 0x0D8: B    crc32_1
+	0xE8, 0x03, 0x28, 0x2A, // 0x0DC: crc32_end: MVN  W8, W8
+	0x68, 0x14, 0x00, 0xB9, // 0x0E0: STR  W8, [X3, #20] (result)
+	0xBF, 0x3F, 0x03, 0xD5, // 0x0E4: done: DMB  SY
+	0x94, 0x06, 0x00, 0x11, // 0x0E8: ADD  W20, W20, #1
+	0x74, 0x42, 0x00, 0xB9, // 0x0EC: STR  W20, [X19, #64] (tail)
+	0xD7, 0xFF, 0xFF, 0x17, // 0x0F0: B    wait
+	0x94, 0x06, 0x00, 0x11, // 0x0F4: stop: ADD  W20, W20, #1
+	0x74, 0x42, 0x00, 0xB9, // 0x0F8: STR  W20, [X19, #64]
+	0x9F, 0x3F, 0x03, 0xD5, // 0x0FC: DSB  SY
+	0x7F, 0x20, 0x03, 0xD5, // 0x100: park: WFI
+	0xFF, 0xFF, 0xFF, 0x17, // 0x104: B    park
+};
+
+static u8 *worker_mem;
+static worker_queue_t queue;
+static bool worker_up = false;
+
+static u32 crc_seq;
+static u32 crc_start;
+static const void *crc_buf;
+static u32 crc_size;
+
+static void worker_reset(void) {
+    // Hold CPU0 in reset again (the bits ccplex_boot_cpu0() cleared)
+    CLOCK(CLK_RST_CONTROLLER_RST_CPUG_CMPLX_SET) = 0x41010001;
+    worker_up = false;
+}
+
+static bool worker_wait_ms(u32 seq, u32 *result, u32 timeout) {
+    if (!worker_up || !seq)
+        return false;
+
+    if (!worker_queue_wait(&queue, seq, result, timeout)) {
+        log_write("WORKER: job %d timed out, disabled\n", seq);
+        worker_reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool worker_wait(u32 seq, u32 *result) {
+    return worker_wait_ms(seq, result, WORKER_JOB_MS);
+}
+
+u32 worker_submit(u32 op, void *dst, const void *src, u32 size, u32 arg) {
+    if (!worker_up)
+        return 0;
+
+    u32 seq = worker_queue_submit(&queue, op, (u32)dst, (u32)src, size, arg, WORKER_JOB_MS);
+    if (!seq) {
+        log_write("WORKER: ring full, disabled\n");
+        worker_reset();
+    }
+
+    return seq;
+}
+
+bool worker_start(void) {
+    if (worker_up)
+        return true;
+
+    // Code, identity map and ring, each on its own page
+    if (!worker_mem)
+        worker_mem = malloc(SZ_4K * 4);
+    if (!worker_mem)
+        return false;
+
+    u8 *code = (u8 *)ALIGN((u32)worker_mem, SZ_4K);
+    u64 *ttbl = (u64 *)(code + SZ_4K);
+    worker_ring_t *ring = (worker_ring_t *)(code + SZ_4K * 2);
+
+    memcpy(code, worker_code, sizeof(worker_code));
+    *(u32 *)(code + 4) = (u32)ring;
+    *(u32 *)(code + 8) = (u32)ttbl;
+
+    // 1GB blocks: IRAM and MMIO as device memory, DRAM as normal non-cacheable
+    ttbl[0] = 0x00000000 | PTE_XN | PTE_AF | PTE_ATTR(0) | PTE_BLOCK;
+    ttbl[1] = 0x40000000 | PTE_XN | PTE_AF | PTE_ATTR(0) | PTE_BLOCK;
+    ttbl[2] = 0x80000000 | PTE_AF | PTE_ATTR(1) | PTE_BLOCK;
+    ttbl[3] = 0xC0000000 | PTE_AF | PTE_ATTR(1) | PTE_BLOCK;
+
+    worker_queue_init(&queue, ring);
+    crc_seq = 0;
+
+    bpmp_mmu_maintenance(BPMP_MMU_MAINT_CLEAN_WAY, false);
+    ccplex_boot_cpu0((u32)code);
+
+    worker_up = true;
+    if (!worker_wait_ms(worker_submit(WORKER_OP_NOP, NULL, NULL, 0, 0), NULL, WORKER_BOOT_MS)) {
+        log_write("WORKER: A57 did not start\n");
+        return false;
+    }
+
+    log_write("WORKER: A57 running\n");
+
+    return true;
+}
+
+void worker_stop(void) {
+    if (!worker_up)
+        return;
+
+    worker_wait_ms(worker_submit(WORKER_OP_STOP, NULL, NULL, 0, 0), NULL, WORKER_BOOT_MS);
+    worker_reset();
+    crc_seq = 0;
+}
+
+void worker_crc32_begin(u32 crc, const void *buf, u32 size) {
+    // A result nobody collected (e.g. after a failed write)
+    if (crc_seq)
+        worker_wait(crc_seq, NULL);
+
+    crc_start = crc;
+    crc_buf = buf;
+    crc_size = size;
+    crc_seq = size >= WORKER_CRC_MIN ? worker_submit(WORKER_OP_CRC32, NULL, buf, size, crc) : 0;
+}
+
+u32 worker_crc32_end(void) {
+    u32 seq = crc_seq;
+    u32 crc;
+
+    crc_seq = 0;
+    if (seq && worker_wait(seq, &crc))
+        return crc;
+
+    return crc32_calc(crc_start, crc_buf, crc_size);
+}
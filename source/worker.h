@@ -0,0 +1,29 @@
+/*
+ * OmniNX Installer - Cortex-A57 worker
+ */
+
+#pragma once
+#include <utils/types.h>
+
+#define WORKER_OP_NOP    0
+#define WORKER_OP_CRC32  1 // result = crc32_calc(arg, src, size)
+#define WORKER_OP_STOP   2
+
+// Boot CPU0 of the A57 cluster into the job loop. Returns false (and the
+// BPMP does all the work itself) if it doesn't answer.
+bool worker_start(void);
+
+// Park the worker and hold CPU0 in reset, e.g. before chainloading
+void worker_stop(void);
+
+// Queue a job, returns its sequence number or 0 if the worker isn't running
+u32 worker_submit(u32 op, void *dst, const void *src, u32 size, u32 arg);
+
+// Wait for a job. False if the worker stopped answering, it is then disabled.
+// The result of a job is only kept until 16 newer jobs are queued.
+bool worker_wait(u32 seq, u32 *result);
+
+// CRC32 of buf computed on the A57 while the BPMP does something else, e.g.
+// writes buf out. _end() returns crc32_calc(crc, buf, size) either way.
+void worker_crc32_begin(u32 crc, const void *buf, u32 size);
+u32 worker_crc32_end(void);
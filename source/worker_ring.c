@@ -0,0 +1,60 @@
+/*
+ * OmniNX Installer - Job ring shared with the A57 worker
+ *
+ * Single producer (BPMP), single consumer (A57). The BPMP fills the job slot
+ * and then moves head, the A57 stores the result and then moves tail; both
+ * counters only grow. The BPMP cache is write-through, so a clean before head
+ * moves and an invalidate before tail is read are all the ordering needed on
+ * this side. Nothing here touches the A57 itself, the host tests run it
+ * against a thread that plays the worker loop.
+ */
+
+#include "worker_ring.h"
+#include <soc/bpmp.h>
+#include <string.h>
+#include <utils/util.h>
+
+void worker_queue_init(worker_queue_t *q, worker_ring_t *ring) {
+    memset(ring, 0, sizeof(worker_ring_t));
+    q->ring = ring;
+    q->head = 0;
+}
+
+bool worker_queue_wait(worker_queue_t *q, u32 seq, u32 *result, u32 timeout) {
+    u32 start = get_tmr_ms();
+
+    while (true) {
+        // Write-through cache, dropping it is enough to see the A57 stores
+        bpmp_mmu_maintenance(BPMP_MMU_MAINT_INVALID_WAY, false);
+        if ((int)(q->ring->tail - seq) >= 0)
+            break;
+
+        if (get_tmr_ms() - start > timeout)
+            return false;
+    }
+
+    if (result)
+        *result = q->ring->jobs[(seq - 1) & (WORKER_RING_JOBS - 1)].result;
+
+    return true;
+}
+
+u32 worker_queue_submit(worker_queue_t *q, u32 op, u32 dst, u32 src, u32 size, u32 arg, u32 timeout) {
+    // Ring full: wait for the oldest job
+    if (q->head - q->ring->tail >= WORKER_RING_JOBS &&
+        !worker_queue_wait(q, q->head - WORKER_RING_JOBS + 1, NULL, timeout))
+        return 0;
+
+    worker_job_t *job = &q->ring->jobs[q->head & (WORKER_RING_JOBS - 1)];
+    job->op = op;
+    job->dst = dst;
+    job->src = src;
+    job->size = size;
+    job->arg = arg;
+
+    // The job must be in DRAM before the head moves
+    bpmp_mmu_maintenance(BPMP_MMU_MAINT_CLEAN_WAY, false);
+    q->ring->head = ++q->head;
+
+    return q->head;
+}
@@ -0,0 +1,44 @@
+/*
+ * OmniNX Installer - Job ring shared with the A57 worker
+ */
+
+#pragma once
+#include <utils/types.h>
+
+#define WORKER_RING_JOBS 16 // Matches the AND mask at 0x064 of the worker loop
+
+// Layout the worker loop reads (source/worker_a57.S)
+typedef struct {
+    u32 op;
+    u32 dst;
+    u32 src;
+    u32 size;
+    u32 arg;
+    u32 result;
+    u32 rsvd[2];
+} worker_job_t;
+
+typedef struct {
+    vu32 head;     // Jobs queued, written by the BPMP
+    u32 rsvd0[15];
+    vu32 tail;     // Jobs done, written by the A57
+    u32 rsvd1[15];
+    worker_job_t jobs[WORKER_RING_JOBS];
+} worker_ring_t;
+
+// BPMP side of a ring
+typedef struct {
+    worker_ring_t *ring;
+    u32 head;      // Jobs queued so far, the sequence number of the last one
+} worker_queue_t;
+
+// Clear the ring before the worker starts on it
+void worker_queue_init(worker_queue_t *q, worker_ring_t *ring);
+
+// Queue a job, waiting up to timeout ms for a free slot if the ring is full.
+// Returns its sequence number, or 0 if no slot became free.
+u32 worker_queue_submit(worker_queue_t *q, u32 op, u32 dst, u32 src, u32 size, u32 arg, u32 timeout);
+
+// Wait up to timeout ms for job seq. Its result stays readable until
+// WORKER_RING_JOBS newer jobs are queued.
+bool worker_queue_wait(worker_queue_t *q, u32 seq, u32 *result, u32 timeout);
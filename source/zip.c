@@ -0,0 +1,571 @@
+/*
+ * OmniNX Installer - Install straight from the release ZIP
+ *
+ * Unpacking the release on a PC leaves thousands of small staging files on the
+ * card, which are then copied once more and deleted again. Instead the archive
+ * is read from front to back: every selected entry is decoded straight into
+ * its final path and its CRC32 is checked while it is written. Stored and
+ * deflated entries are supported; ZIP64, encryption and multi-disk archives
+ * are not used by the release and are rejected.
+ */
+
+#include "zip.h"
+#include "fs.h"
+#include "inflate.h"
+#include "inventory.h"
+#include "progress.h"
+#include "verify.h"
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
+#include <string.h>
+#include <utils/sprintf.h>
+#include <utils/util.h>
+
+#define ZIP_PATTERN      "OmniNX-*.zip"
+#define ZIP_SIG_EOCD     0x06054B50
+#define ZIP_SIG_CENTRAL  0x02014B50
+#define ZIP_SIG_LOCAL    0x04034B50
+#define ZIP_EOCD_SIZE    22
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIZE   30
+#define ZIP_EOCD_SEARCH  (0x10000 + ZIP_EOCD_SIZE) // Max comment length + record
+
+#define ZIP_METHOD_STORE   0
+#define ZIP_METHOD_DEFLATE 8
+
+#define ZIP_IN_SIZE  0x40000  // Compressed read size
+#define ZIP_OUT_SIZE 0x100000 // Output window, also the write size
+
+typedef struct {
+    u32 lho;     // Local header offset
+    u32 csize;
+    u32 usize;
+    u32 crc;
+    u16 method;
+    u16 name_len;
+    const char *name; // Not NUL terminated, points into the central directory
+} zip_entry_t;
+
+typedef struct {
+    FIL fp;
+    bool opened;
+    u8 *cd;
+    u32 cd_size;
+    zip_entry_t *ents;
+    u32 count;
+    const char *top;   // Pack folder
+    u32 top_len;       // Length of "<pack folder>/" to strip from the names
+    u32 remaining;     // Compressed bytes left of the current entry
+    FIL *out;          // Destination file, or
+    u8 *mem;           // destination buffer of zip_read_entry()
+    u32 mem_pos;
+    verify_sha_t *sha;
+    int out_res;
+} zip_t;
+
+static zip_t zip;
+static char zip_path[256];
+
+static u16 rd16(const u8 *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static u32 rd32(const u8 *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+// Pack folder inside the archive, e.g. "OmniNX Standard"
+static const char *zip_top_folder(omninx_variant_t variant) {
+    const char *staging = get_staging_path(variant);
+    return staging ? staging + 4 : NULL; // Skip "sd:/"
+}
+
+static int zip_read_at(FIL *fp, u32 ofs, void *buf, u32 size) {
+    UINT br;
+
+    int res = f_lseek(fp, ofs);
+    if (res == FR_OK)
+        res = f_read(fp, buf, size, &br);
+    if (res == FR_OK && br != size)
+        res = FR_INT_ERR;
+
+    return res;
+}
+
+// Load the central directory of an open archive
+static int zip_read_central(FIL *fp, u8 **cd, u32 *cd_size, u32 *count) {
+    u32 fsize = f_size(fp);
+    u32 search = fsize < ZIP_EOCD_SEARCH ? fsize : ZIP_EOCD_SEARCH;
+    int res;
+
+    if (fsize < ZIP_EOCD_SIZE)
+        return FR_INT_ERR;
+
+    u8 *tail = malloc(search);
+    if (!tail)
+        return FR_NOT_ENOUGH_CORE;
+
+    res = zip_read_at(fp, fsize - search, tail, search);
+    if (res != FR_OK) {
+        free(tail);
+        return res;
+    }
+
+    // The end record is followed only by the archive comment
+    const u8 *eocd = NULL;
+    for (u32 i = search - ZIP_EOCD_SIZE + 1; i-- > 0;) {
+        if (rd32(tail + i) == ZIP_SIG_EOCD) {
+            eocd = tail + i;
+            break;
+        }
+    }
+
+    if (!eocd || rd16(eocd + 4) || rd16(eocd + 6) || rd16(eocd + 8) != rd16(eocd + 10) ||
+        rd16(eocd + 10) == 0xFFFF || rd32(eocd + 16) == 0xFFFFFFFF) {
+        free(tail);
+        return FR_INT_ERR; // Missing, multi-disk or ZIP64
+    }
+
+    *count = rd16(eocd + 10);
+    *cd_size = rd32(eocd + 12);
+    u32 cd_ofs = rd32(eocd + 16);
+    free(tail);
+
+    if ((u64)cd_ofs + *cd_size > fsize)
+        return FR_INT_ERR;
+
+    *cd = malloc(*cd_size ? *cd_size : 1);
+    if (!*cd)
+        return FR_NOT_ENOUGH_CORE;
+
+    res = zip_read_at(fp, cd_ofs, *cd, *cd_size);
+    if (res != FR_OK) {
+        free(*cd);
+        *cd = NULL;
+    }
+
+    return res;
+}
+
+const char *zip_find(omninx_variant_t *variant) {
+    DIR dir;
+    FILINFO fno;
+    FIL fp;
+    u8 *cd;
+    u32 cd_size, count;
+
+    if (f_findfirst(&dir, &fno, "sd:/", ZIP_PATTERN) != FR_OK)
+        return NULL;
+
+    for (; fno.fname[0]; f_findnext(&dir, &fno)) {
+        if (fno.fattrib & AM_DIR)
+            continue;
+
+        s_printf(zip_path, "sd:/%s", fno.fname);
+        if (f_open(&fp, zip_path, FA_READ) != FR_OK)
+            continue;
+
+        int res = zip_read_central(&fp, &cd, &cd_size, &count);
+        f_close(&fp);
+        if (res != FR_OK || cd_size < ZIP_CENTRAL_SIZE || rd32(cd) != ZIP_SIG_CENTRAL) {
+            if (res == FR_OK)
+                free(cd);
+            continue;
+        }
+
+        // The first entry inside a pack folder tells the variant
+        omninx_variant_t found = VARIANT_NONE;
+        for (u32 ofs = 0, i = 0; i < count && found == VARIANT_NONE; i++) {
+            const u8 *c = cd + ofs;
+            if (ofs + ZIP_CENTRAL_SIZE > cd_size || rd32(c) != ZIP_SIG_CENTRAL)
+                break;
+
+            const char *name = (const char *)c + ZIP_CENTRAL_SIZE;
+            u32 name_len = rd16(c + 28);
+            ofs += ZIP_CENTRAL_SIZE + name_len + rd16(c + 30) + rd16(c + 32);
+
+            for (omninx_variant_t v = VARIANT_STANDARD; v <= VARIANT_OC; v++) {
+                const char *top = zip_top_folder(v);
+                u32 len = strlen(top);
+                if (name_len > len && !strncmp(name, top, len) && name[len] == '/') {
+                    found = v;
+                    break;
+                }
+            }
+        }
+        free(cd);
+
+        if (found != VARIANT_NONE) {
+            f_closedir(&dir);
+            if (variant)
+                *variant = found;
+            return zip_path;
+        }
+    }
+
+    f_closedir(&dir);
+    return NULL;
+}
+
+int zip_open(const char *path, omninx_variant_t variant, zip_filter_t filter, void *ctx, u32 *count, u64 *bytes) {
+    char rel[256];
+    u32 total;
+    const char *top = zip_top_folder(variant);
+
+    memset(&zip, 0, sizeof(zip));
+    *count = 0;
+    *bytes = 0;
+
+    if (!top)
+        return FR_INVALID_PARAMETER;
+
+    int res = f_open(&zip.fp, path, FA_READ);
+    if (res != FR_OK)
+        return res;
+    zip.opened = true;
+
+    res = zip_read_central(&zip.fp, &zip.cd, &zip.cd_size, &total);
+    if (res == FR_OK) {
+        zip.ents = malloc((total ? total : 1) * sizeof(zip_entry_t));
+        if (!zip.ents)
+            res = FR_NOT_ENOUGH_CORE;
+    }
+    if (res != FR_OK) {
+        zip_close();
+        return res;
+    }
+
+    zip.top = top;
+    zip.top_len = strlen(top) + 1;
+
+    u32 ofs = 0;
+    for (u32 i = 0; i < total; i++) {
+        const u8 *c = zip.cd + ofs;
+        if (ofs + ZIP_CENTRAL_SIZE > zip.cd_size || rd32(c) != ZIP_SIG_CENTRAL) {
+            zip_close();
+            return FR_INT_ERR;
+        }
+
+        u32 name_len = rd16(c + 28);
+        u32 rec_len = ZIP_CENTRAL_SIZE + name_len + rd16(c + 30) + rd16(c + 32);
+        if (ofs + rec_len > zip.cd_size) {
+            zip_close();
+            return FR_INT_ERR;
+        }
+        ofs += rec_len;
+
+        // Only the pack folder, skipping the folder entry itself
+        const char *name = (const char *)c + ZIP_CENTRAL_SIZE;
+        if (name_len <= zip.top_len || name_len - zip.top_len >= sizeof(rel) ||
+            strncmp(name, top, zip.top_len - 1) || name[zip.top_len - 1] != '/')
+            continue;
+
+        memcpy(rel, name + zip.top_len, name_len - zip.top_len);
+        rel[name_len - zip.top_len] = 0;
+        if (filter && !filter(rel, ctx))
+            continue;
+
+        zip_entry_t *e = &zip.ents[zip.count];
+        e->method = rd16(c + 10);
+        e->crc = rd32(c + 16);
+        e->csize = rd32(c + 20);
+        e->usize = rd32(c + 24);
+        e->lho = rd32(c + 42);
+        e->name_len = name_len;
+        e->name = name;
+
+        // Encrypted entries and unsupported methods
+        if ((rd16(c + 8) & 1) || (e->method != ZIP_METHOD_STORE && e->method != ZIP_METHOD_DEFLATE)) {
+            log_write("ZIP: unsupported entry %s\n", rel);
+            zip_close();
+            return FR_INT_ERR;
+        }
+
+        zip.count++;
+        *bytes += e->usize;
+        if (name[name_len - 1] != '/')
+            (*count)++;
+    }
+
+    // Read the archive front to back (entries are usually in order already)
+    for (u32 i = 1; i < zip.count; i++) {
+        zip_entry_t tmp = zip.ents[i];
+        u32 j = i;
+        while (j > 0 && zip.ents[j - 1].lho > tmp.lho) {
+            zip.ents[j] = zip.ents[j - 1];
+            j--;
+        }
+        zip.ents[j] = tmp;
+    }
+
+    log_write("ZIP: %s, %d of %d entries selected\n", path, zip.count, total);
+
+    return FR_OK;
+}
+
+static int zip_in_read(void *ctx, u8 *buf, u32 size, u32 *read) {
+    UINT br = 0;
+
+    if (size > zip.remaining)
+        size = zip.remaining;
+
+    int res = size ? f_read(&zip.fp, buf, size, &br) : FR_OK;
+    zip.remaining -= br;
+    *read = br;
+
+    return res;
+}
+
+static int zip_out_write(void *ctx, const u8 *buf, u32 size) {
+    UINT bw = 0;
+
+    if (zip.mem) {
+        // Never more than the central directory announced
+        if (size > ((zip_entry_t *)ctx)->usize - zip.mem_pos)
+            return zip.out_res = FR_INT_ERR;
+        memcpy(zip.mem + zip.mem_pos, buf, size);
+        zip.mem_pos += size;
+        return FR_OK;
+    }
+
+    // The SE hashes the decoded data while it is written out
+    verify_update(zip.sha, buf, size);
+    zip.out_res = f_write(zip.out, buf, size, &bw);
+    verify_wait(zip.sha);
+    if (zip.out_res == FR_OK && bw != size)
+        zip.out_res = FR_DENIED; // Card full
+    if (zip.out_res == FR_OK)
+        progress_add(size, 0);
+
+    return zip.out_res;
+}
+
+// Create the parent directories of path, remembering the last one created
+static void zip_mkdirs(char *path) {
+    static char last[256];
+    char *slash = strrchr(path, '/');
+
+    if (!slash)
+        return;
+
+    *slash = 0;
+    if (strcmp(last, path)) {
+        for (char *p = strchr(path + 4, '/'); ; p = strchr(p + 1, '/')) {
+            if (p)
+                *p = 0;
+            f_mkdir(path);
+            if (!p)
+                break;
+            *p = '/';
+        }
+        strcpy(last, path);
+    }
+    *slash = '/';
+}
+
+// Decode an entry to zip.out or zip.mem, checking its size and CRC32
+static int zip_decode(inflate_t *inf, const zip_entry_t *e) {
+    u8 local[ZIP_LOCAL_SIZE];
+    int res;
+
+    // The local header may carry a different extra field than the central one
+    res = zip_read_at(&zip.fp, e->lho, local, ZIP_LOCAL_SIZE);
+    if (res != FR_OK)
+        return res;
+    if (rd32(local) != ZIP_SIG_LOCAL)
+        return FR_INT_ERR;
+    res = f_lseek(&zip.fp, e->lho + ZIP_LOCAL_SIZE + rd16(local + 26) + rd16(local + 28));
+    if (res != FR_OK)
+        return res;
+
+    zip.remaining = e->csize;
+    zip.out_res = FR_OK;
+
+    u32 crc, size;
+    if (e->method == ZIP_METHOD_DEFLATE) {
+        int ires = inflate_stream(inf, zip_in_read, zip_out_write, (void *)e);
+        crc = inf->crc;
+        size = inf->pos;
+        if (ires != INFLATE_OK) {
+            res = zip.out_res != FR_OK ? zip.out_res : FR_INT_ERR;
+            log_write("  ERROR inflate: %d\n", ires);
+        }
+    } else {
+        u32 read;
+        crc = 0;
+        size = 0;
+        while (zip.remaining) {
+            res = zip_in_read(NULL, inf->out, inf->out_mask + 1, &read);
+            if (res == FR_OK && !read)
+                res = FR_INT_ERR;
+            if (res == FR_OK)
+                res = zip_out_write((void *)e, inf->out, read);
+            if (res != FR_OK)
+                break;
+            crc = crc32_calc(crc, inf->out, read);
+            size += read;
+        }
+    }
+
+    if (res == FR_OK && (size != e->usize || crc != e->crc)) {
+        log_write("  ERROR: CRC32 %08X, expected %08X\n", crc, e->crc);
+        res = FR_INT_ERR;
+    }
+
+    return res;
+}
+
+static int zip_extract_entry(inflate_t *inf, const zip_entry_t *e, const char *dst) {
+    FIL fp;
+    verify_sha_t sha;
+
+    int res = f_open(&fp, dst, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) {
+        log_write("  ERROR open dst: %s\n", fs_error_str(res));
+        return res;
+    }
+
+    // One contiguous run for the whole file, as in file_copy()
+    if (e->usize)
+        f_expand(&fp, e->usize, 1);
+
+    verify_begin(&sha, e->usize);
+    zip.out = &fp;
+    zip.sha = &sha;
+
+    res = zip_decode(inf, e);
+
+    if (res == FR_OK)
+        inventory_add(dst, e->usize, e->crc, fp.obj.sclust);
+    f_close(&fp);
+
+    if (res == FR_OK)
+        res = verify_end(&sha, dst);
+
+    // Never leave a damaged file behind
+    if (res != FR_OK)
+        f_unlink(dst);
+
+    return res;
+}
+
+int zip_read_entry(const char *rel, u8 **buf, u32 *size) {
+    zip_entry_t e;
+    inflate_t inf;
+    u32 rel_len = strlen(rel);
+    int res = FR_NO_FILE;
+
+    *buf = NULL;
+    *size = 0;
+
+    if (!zip.cd || !zip.top)
+        return FR_INVALID_OBJECT;
+
+    // Entries outside the filter are not in zip.ents, look in the central directory
+    memset(&e, 0, sizeof(e));
+    for (u32 ofs = 0; ofs + ZIP_CENTRAL_SIZE <= zip.cd_size;) {
+        const u8 *c = zip.cd + ofs;
+        if (rd32(c) != ZIP_SIG_CENTRAL)
+            break;
+
+        const char *name = (const char *)c + ZIP_CENTRAL_SIZE;
+        u32 name_len = rd16(c + 28);
+        ofs += ZIP_CENTRAL_SIZE + name_len + rd16(c + 30) + rd16(c + 32);
+
+        if (name_len == zip.top_len + rel_len && !strncmp(name, zip.top, zip.top_len - 1) &&
+            name[zip.top_len - 1] == '/' && !strncmp(name + zip.top_len, rel, rel_len)) {
+            e.method = rd16(c + 10);
+            e.crc = rd32(c + 16);
+            e.csize = rd32(c + 20);
+            e.usize = rd32(c + 24);
+            e.lho = rd32(c + 42);
+            res = FR_OK;
+            break;
+        }
+    }
+
+    if (res != FR_OK)
+        return res;
+    if (e.method != ZIP_METHOD_STORE && e.method != ZIP_METHOD_DEFLATE)
+        return FR_INT_ERR;
+
+    zip.mem = malloc(e.usize + 1);
+    if (!zip.mem)
+        return FR_NOT_ENOUGH_CORE;
+    if (inflate_init(&inf, ZIP_IN_SIZE, ZIP_OUT_SIZE) != INFLATE_OK) {
+        free(zip.mem);
+        zip.mem = NULL;
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    zip.mem_pos = 0;
+    res = zip_decode(&inf, &e);
+    inflate_end(&inf);
+
+    if (res == FR_OK) {
+        *buf = zip.mem;
+        *size = e.usize;
+    } else {
+        free(zip.mem);
+    }
+    zip.mem = NULL;
+
+    return res;
+}
+
+int zip_extract(const char *dst_root) {
+    inflate_t inf;
+    char dst[256];
+    int res = FR_OK;
+
+    if (inflate_init(&inf, ZIP_IN_SIZE, ZIP_OUT_SIZE) != INFLATE_OK)
+        return FR_NOT_ENOUGH_CORE;
+
+    for (u32 i = 0; i < zip.count; i++) {
+        const zip_entry_t *e = &zip.ents[i];
+        u32 len = strlen(dst_root);
+        u32 rel_len = e->name_len - zip.top_len;
+
+        if (len + rel_len + 1 >= sizeof(dst)) {
+            res = FR_INVALID_NAME;
+            break;
+        }
+        memcpy(dst, dst_root, len);
+        if (len && dst[len - 1] != '/')
+            dst[len++] = '/';
+        memcpy(dst + len, e->name + zip.top_len, rel_len);
+        dst[len + rel_len] = 0;
+
+        if (dst[len + rel_len - 1] == '/') {
+            // Directory entry, the trailing slash makes it create the directory itself
+            zip_mkdirs(dst);
+        } else {
+            zip_mkdirs(dst);
+            log_write("UNZIP: %s (%d bytes)\n", dst, e->usize);
+            if (inventory_unchanged_crc(dst, e->usize, e->crc)) {
+                progress_add(e->usize, 1);
+            } else {
+                res = zip_extract_entry(&inf, e, dst);
+                if (res == FR_OK)
+                    progress_add(0, 1);
+            }
+        }
+
+        if (res != FR_OK) {
+            log_write("  ERROR: %s\n", fs_error_str(res));
+            break;
+        }
+    }
+
+    inflate_end(&inf);
+
+    return res;
+}
+
+void zip_close(void) {
+    if (zip.opened)
+        f_close(&zip.fp);
+    free(zip.cd);
+    free(zip.ents);
+    memset(&zip, 0, sizeof(zip));
+}
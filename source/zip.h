@@ -0,0 +1,30 @@
+/*
+ * OmniNX Installer - Install straight from the release ZIP
+ */
+
+#pragma once
+#include "version.h"
+#include <utils/types.h>
+
+// Decides whether an entry is installed. rel is the path below the pack folder.
+typedef bool (*zip_filter_t)(const char *rel, void *ctx);
+
+// Find sd:/OmniNX-*.zip and tell the pack variant from its top folder.
+// Returns the archive path or NULL if there is no usable archive.
+const char *zip_find(omninx_variant_t *variant);
+
+// Read the central directory of the archive and select the entries of the
+// variant's folder that pass the filter. count and bytes receive the number of
+// selected files (directory entries left out) and their uncompressed size.
+int zip_open(const char *path, omninx_variant_t variant, zip_filter_t filter, void *ctx, u32 *count, u64 *bytes);
+
+// Extract the selected entries below dst_root in archive order, checking the
+// CRC32 of every entry while it is written. Decoded bytes and finished files
+// are reported to the progress line (progress_add()).
+int zip_extract(const char *dst_root);
+
+// Decode one entry of the pack folder into a new buffer, whether the filter
+// selected it or not. The caller frees *buf.
+int zip_read_entry(const char *rel, u8 **buf, u32 *size);
+
+void zip_close(void);
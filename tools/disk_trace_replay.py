@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+#
+# OmniNX Installer - SD I/O trace replay
+#
+# Replays a trace written by a DISK_TRACE=1 build (sd:/config/omninx/disk_trace.bin)
+# against a simple SD card cost model:
+#
+#   cmd      fixed cost of every card command
+#   turn     extra cost when the card switches between reading and writing
+#   misalign extra cost of a write that does not start or end on an AU
+#   rd/wr    transfer rate in MB/s
+#   erase    cost of one erase command
+#
+# "card" replays the transfers that really reached the card, so the model can
+# be checked against the measured durations. "fatfs" replays the FatFs calls
+# through a model of the write shaping in diskio.c with the given buffer
+# settings, to see what other settings would do on the same card.
+#
+#   disk_trace_replay.py disk_trace.bin
+#   disk_trace_replay.py --layer fatfs --shape 2048 --shape-min 8 disk_trace.bin
+#
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0x43525444
+VERSION = 1
+
+READ, WRITE, SYNC, CARD_READ, CARD_WRITE, CARD_ERASE = range(6)
+OP_NAMES = ['read', 'write', 'sync', 'card read', 'card write', 'card erase']
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    hdr = struct.unpack_from('<8I', data)
+    if hdr[0] != MAGIC or hdr[1] != VERSION:
+        sys.exit('%s: not a version %d disk trace' % (path, VERSION))
+
+    ents = []
+    for i in range(hdr[2]):
+        start, dur, sector, count = struct.unpack_from('<4I', data, 32 + i * 16)
+        ents.append((start, dur, count >> 24, sector, count & 0xFFFFFF))
+
+    info = {'recorded': hdr[3], 'au': hdr[4], 'align': hdr[5], 'min': hdr[6]}
+    return info, ents
+
+
+class Card:
+    def __init__(self, args, au):
+        self.args = args
+        self.au = au
+        self.last = None
+        self.us = 0.0
+        self.cmds = [0] * 6
+        self.sectors = [0] * 6
+
+    def op(self, op, sector, count):
+        a = self.args
+        t = a.cmd_us
+
+        if op == CARD_ERASE:
+            t = a.erase_us
+        else:
+            if self.last is not None and self.last != op:
+                t += a.turn_us
+            if op == CARD_WRITE:
+                if sector % self.au or (sector + count) % self.au:
+                    t += a.misalign_us
+                t += count * 512 / (a.wr_mbps * 1.048576)
+            else:
+                t += count * 512 / (a.rd_mbps * 1.048576)
+            self.last = op
+
+        self.cmds[op] += 1
+        self.sectors[op] += count
+        self.us += t
+
+
+class Shaper:
+    # Same rules as _ws_write()/_ws_flush() in diskio.c
+    def __init__(self, card, buf, align, min_sectors):
+        self.card = card
+        self.buf = buf
+        self.align = align
+        self.min = min_sectors
+        self.sector = 0
+        self.count = 0
+
+    def flush(self):
+        if self.count:
+            self.card.op(CARD_WRITE, self.sector, self.count)
+            self.count = 0
+
+    def flush_aligned(self):
+        end = (self.sector + self.count) // self.align * self.align
+        if end <= self.sector:
+            if self.count == self.buf:
+                self.flush()
+            return
+        self.card.op(CARD_WRITE, self.sector, end - self.sector)
+        self.count -= end - self.sector
+        self.sector = end
+
+    def write(self, sector, count):
+        if not self.align:
+            self.card.op(CARD_WRITE, sector, count)
+            return
+
+        if not self.count or sector != self.sector + self.count:
+            self.flush()
+            if count < self.min:
+                self.card.op(CARD_WRITE, sector, count)
+                return
+            if not sector % self.align and count >= self.align:
+                direct = count // self.align * self.align
+                self.card.op(CARD_WRITE, sector, direct)
+                sector += direct
+                count -= direct
+                if not count:
+                    return
+            self.sector = sector
+
+        while count:
+            chunk = min(count, self.buf - self.count)
+            self.count += chunk
+            count -= chunk
+            if self.count >= self.align or self.count == self.buf:
+                self.flush_aligned()
+
+    def read(self, sector, count):
+        if self.count and sector < self.sector + self.count and sector + count > self.sector:
+            self.flush()
+        self.card.op(CARD_READ, sector, count)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Replay an OmniNX SD I/O trace against a cost model')
+    p.add_argument('trace')
+    p.add_argument('--layer', choices=['card', 'fatfs'], default='card')
+    p.add_argument('--cmd-us', type=float, default=150.0)
+    p.add_argument('--turn-us', type=float, default=250.0)
+    p.add_argument('--misalign-us', type=float, default=2000.0)
+    p.add_argument('--rd-mbps', type=float, default=80.0)
+    p.add_argument('--wr-mbps', type=float, default=40.0)
+    p.add_argument('--erase-us', type=float, default=5000.0)
+    p.add_argument('--au', type=int, help='AU in sectors (default: from the trace)')
+    p.add_argument('--shape', type=int, help='fatfs: flush boundary in sectors, 0 = no shaping (default: from the trace)')
+    p.add_argument('--shape-min', type=int, help='fatfs: smaller writes pass through (default: from the trace)')
+    p.add_argument('--shape-buf', type=int, default=0x4000, help='fatfs: buffer size in sectors')
+    args = p.parse_args()
+
+    info, ents = load(args.trace)
+    au = args.au or info['au']
+    card = Card(args, au)
+
+    print('%d entries (%d recorded), AU %d sectors, shaping %d/%d' %
+          (len(ents), info['recorded'], info['au'], info['align'], info['min']))
+
+    measured = 0
+    if args.layer == 'card':
+        for start, dur, op, sector, count in ents:
+            if op >= CARD_READ:
+                card.op(op, sector, count)
+                measured += dur
+    else:
+        align = info['align'] if args.shape is None else args.shape
+        min_sectors = info['min'] if args.shape_min is None else args.shape_min
+        shaper = Shaper(card, args.shape_buf, align, min_sectors)
+        for start, dur, op, sector, count in ents:
+            if op == WRITE:
+                shaper.write(sector, count)
+            elif op == READ:
+                shaper.read(sector, count)
+            elif op == SYNC:
+                shaper.flush()
+            elif op == CARD_ERASE:
+                card.op(op, sector, count)
+            if op >= CARD_READ:
+                measured += dur
+        shaper.flush()
+
+    for op in (CARD_READ, CARD_WRITE, CARD_ERASE):
+        print('  %-10s %8d cmds %10d MB' % (OP_NAMES[op], card.cmds[op], card.sectors[op] >> 11))
+    print('measured card time:  %10.3f s' % (measured / 1e6))
+    print('predicted card time: %10.3f s' % (card.us / 1e6))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,179 @@
+/*
+ * OmniNX Installer - Host benchmark: FatFs LFN working buffers
+ *
+ * Time and heap calls per call of the FatFs functions that take an LFN
+ * working buffer, on a fresh FAT32 image. host.mk links this twice, against
+ * ff.c with the payload's FF_NAMBUF_DEPTH and against ff.c with the pool off
+ * (every call does ff_memalloc/ff_memfree, as before the pool), and
+ * make host-nambuf runs both. The lookups stay within one directory sector,
+ * so the image is hardly read and what is left is the call itself. Each
+ * function is run BENCH_RUNS times and the median time per call is printed
+ * with the fastest and slowest run, which shows how much of a difference is
+ * noise. Host malloc is cheaper than the BDK's first-fit heap, the times are
+ * only the host's; the heap calls are what the payload would do.
+ *
+ *   bench_nambuf IMAGE
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "host.h"
+#include <libs/fatfs/ff.h>
+#include <nx_sd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_IMG_SIZE (256ULL << 20)
+#define BENCH_FILES    4
+#define BENCH_CALLS    20000
+#define BENCH_RUNS     9
+
+extern bool sd_mounted;
+
+static const char *const names[BENCH_FILES] = {
+    "sd:/bench/Long file name 1.bin", "sd:/bench/Long file name 2.bin",
+    "sd:/bench/Long file name 3.bin", "sd:/bench/Long file name 4.bin"
+};
+
+static u32 errors;
+
+static u64 now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void ok(FRESULT res) {
+    if (res != FR_OK)
+        errors++;
+}
+
+/* One call (or pair of calls) per function */
+
+static u32 run_stat(u32 i) {
+    FILINFO fno;
+
+    ok(f_stat(names[i % BENCH_FILES], &fno));
+    return 1;
+}
+
+static u32 run_stat_missing(u32 i) {
+    FILINFO fno;
+
+    if (f_stat("sd:/bench/Not there.bin", &fno) != FR_NO_FILE)
+        errors++;
+    return 1;
+}
+
+static u32 run_open(u32 i) {
+    FIL fp;
+
+    ok(f_open(&fp, names[i % BENCH_FILES], FA_READ));
+    ok(f_close(&fp));
+    return 1;
+}
+
+static u32 run_create_unlink(u32 i) {
+    FIL fp;
+
+    ok(f_open(&fp, "sd:/bench/Created and removed.bin", FA_WRITE | FA_CREATE_ALWAYS));
+    ok(f_close(&fp));
+    ok(f_unlink("sd:/bench/Created and removed.bin"));
+    return 2;
+}
+
+static u32 run_rename(u32 i) {
+    ok(f_rename(names[0], "sd:/bench/Renamed file.bin"));
+    ok(f_rename("sd:/bench/Renamed file.bin", names[0]));
+    return 2;
+}
+
+static u32 run_readdir(u32 i) {
+    FILINFO fno;
+    DIR dir;
+    u32 calls = 1;
+
+    ok(f_opendir(&dir, "sd:/bench"));
+    do {
+        ok(f_readdir(&dir, &fno));
+        calls++;
+    } while (fno.fname[0]);
+    f_closedir(&dir);
+
+    return calls;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void bench(const char *name, u32 (*fn)(u32)) {
+    double ns[BENCH_RUNS];
+    u32 total = 0;
+    u32 heap = host_heap_calls();
+
+    for (u32 r = 0; r < BENCH_RUNS; r++) {
+        u32 calls = 0;
+        u64 start = now_ns();
+
+        for (u32 i = 0; i < BENCH_CALLS; i++)
+            calls += fn(i);
+
+        ns[r] = (double)(now_ns() - start) / calls;
+        total += calls;
+    }
+
+    heap = host_heap_calls() - heap;
+    qsort(ns, BENCH_RUNS, sizeof(ns[0]), cmp_double);
+    printf("  %-22s %7.0f ns/call (%.0f-%.0f)  %4.1f heap calls/call\n", name, ns[BENCH_RUNS / 2],
+        ns[0], ns[BENCH_RUNS - 1], (double)heap / total);
+}
+
+int main(int argc, char **argv) {
+    static u8 work[0x100000];
+    FIL fp;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: bench_nambuf IMAGE\n");
+        return 2;
+    }
+
+    remove(argv[1]);
+    if (!host_sd_create(argv[1], BENCH_IMG_SIZE) || !host_sd_open(argv[1], 4096) ||
+        f_mkfs("sd:", FM_FAT32, 0, work, sizeof(work)) != FR_OK ||
+        f_mount(&sd_fs, "sd:", 1) != FR_OK) {
+        fprintf(stderr, "bench_nambuf: can't set up %s\n", argv[1]);
+        return 1;
+    }
+    sd_mounted = true;
+
+    ok(f_mkdir("sd:/bench"));
+    for (u32 i = 0; i < BENCH_FILES; i++) {
+        ok(f_open(&fp, names[i], FA_WRITE | FA_CREATE_ALWAYS));
+        ok(f_close(&fp));
+    }
+
+    printf("FF_NAMBUF_DEPTH %d, median of %d runs of %d calls each:\n", FF_NAMBUF_DEPTH, BENCH_RUNS, BENCH_CALLS);
+    bench("f_stat", run_stat);
+    bench("f_stat (no file)", run_stat_missing);
+    bench("f_open + f_close", run_open);
+    bench("f_open new + f_unlink", run_create_unlink);
+    bench("f_rename", run_rename);
+    bench("f_opendir + f_readdir", run_readdir);
+
+    f_mount(NULL, "sd:", 1);
+    sd_mounted = false;
+    host_sd_close();
+    remove(argv[1]);
+
+    if (errors)
+        printf("%d calls failed\n", errors);
+
+    return errors ? 1 : 0;
+}
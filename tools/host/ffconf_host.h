@@ -0,0 +1,18 @@
+/*
+ * OmniNX Installer - Host build: FatFs configuration
+ *
+ * The payload's configuration, with the FAT cache in a host buffer instead of
+ * the fixed DRAM region.
+ */
+
+#include "../../source/libs/fatfs/ffconf.h"
+
+#undef FF_FAT_CACHE_ADDR
+extern unsigned char host_fat_cache[];
+#define FF_FAT_CACHE_ADDR host_fat_cache
+
+// bench_nambuf builds a second ff.c with the pool off, to compare against
+#ifdef HOST_NAMBUF_DEPTH
+#undef FF_NAMBUF_DEPTH
+#define FF_NAMBUF_DEPTH HOST_NAMBUF_DEPTH
+#endif
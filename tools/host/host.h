@@ -0,0 +1,22 @@
+/*
+ * OmniNX Installer - Host build
+ */
+
+#pragma once
+#include <utils/types.h>
+
+// Open the image file that stands in for the SD card. au_kb is the AU the
+// card reports (0 for none). Returns false if the file can't be opened.
+bool host_sd_open(const char *path, u32 au_kb);
+void host_sd_close(void);
+
+// Create or resize the image file to size bytes (truncated to sectors) and
+// write an MBR with one FAT32 partition to it, for f_mkfs to format
+bool host_sd_create(const char *path, u64 size);
+
+// malloc/calloc/free calls of the payload code so far and bytes in use
+u32 host_heap_calls(void);
+u32 host_heap_used(void);
+
+// Print what is left of the last console line
+void host_gfx_flush(void);
@@ -0,0 +1,104 @@
+################################################################################
+# Host build (Linux, gcc): the install path over an image file instead of the SD
+#
+#   make host-bench    build/host/host-bench, see tools/host/host_bench.c
+#   make host-test     build and run the tests in tools/host/test_*.c
+#                      (ZIPS="OmniNX-*.zip ..." also extracts release archives)
+#   make host-nambuf   FatFs calls with and without the LFN buffer pool
+#
+# No devkitARM needed. The payload sources are built unchanged, only the
+# hardware below them (sdmmc, SE, display, timers, A57 worker) is replaced by
+# the files in tools/host.
+################################################################################
+
+HOSTCC ?= gcc
+HOSTDIR := tools/host
+HOSTBUILD := $(BUILDDIR)/host
+
+HOST_SRCS := install.c fs.c backup.c version.c copy_plan.c inventory.c verify.c zip.c inflate.c \
+	fs_stats.c progress.c sd_profile.c nx_sd.c worker_ring.c libs/fatfs/diskio.c libs/fatfs/ffsystem.c
+HOST_BDK_SRCS := libs/fatfs/ff.c libs/fatfs/ffunicode.c utils/util.c utils/sprintf.c utils/ini.c utils/dirlist.c
+HOST_STUBS := host_sd.c host_gfx.c host_sys.c
+
+HOST_OBJS := $(patsubst %.c, $(HOSTBUILD)/src/%.o, $(HOST_SRCS))
+HOST_OBJS += $(patsubst %.c, $(HOSTBUILD)/bdk/%.o, $(HOST_BDK_SRCS))
+HOST_OBJS += $(patsubst %.c, $(HOSTBUILD)/%.o, $(HOST_STUBS))
+
+HOST_DEFINES := -DIPL_LOAD_ADDR=$(IPL_LOAD_ADDR) -DVERSION='"$(VERSION)"'
+HOST_DEFINES += -DGFX_INC=$(GFX_INC) -DFFCFG_INC='"../$(HOSTDIR)/ffconf_host.h"'
+
+# The payload declares its own malloc/free and printf-like helpers
+HOST_CFLAGS := -O2 -g -std=gnu11 -ffunction-sections -fdata-sections -Wall -Wno-missing-braces \
+	-Wno-builtin-declaration-mismatch -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+	$(HOST_DEFINES) $(BDKINC) -I$(SOURCEDIR)
+
+# malloc/calloc/free are counted in host_sys.c, the BDK timers come from there too
+HOST_LDFLAGS := -Wl,--gc-sections
+HOST_LDFLAGS += $(foreach f, malloc calloc free $(FS_WRAP), -Wl,--wrap=$(f))
+HOST_UTIL_DEFINES := $(foreach f, get_tmr_us get_tmr_ms get_tmr_s msleep usleep, -D$(f)=bdk_$(f))
+
+.PHONY: host-bench host-test host-nambuf
+HOST_TESTS := test_inflate test_crc test_worker
+
+.SECONDARY: $(patsubst %, $(HOSTBUILD)/%.o, $(HOST_TESTS))
+$(patsubst %, $(HOSTBUILD)/%.o, $(HOST_TESTS)): $(HOSTDIR)/test.h
+
+host-bench: $(HOSTBUILD)/host-bench
+
+host-test: $(patsubst %, $(HOSTBUILD)/%, $(HOST_TESTS))
+	$(HOSTBUILD)/test_inflate $(HOSTBUILD)/test.img $(ZIPS)
+	$(HOSTBUILD)/test_crc
+	$(HOSTBUILD)/test_worker
+	@if command -v llvm-mc >/dev/null || command -v aarch64-none-elf-as >/dev/null; then \
+		python3 tools/worker_code.py; else echo "worker_code.py skipped, no AArch64 assembler"; fi
+
+$(HOSTBUILD)/host-bench: $(HOST_OBJS) $(HOSTBUILD)/host_bench.o
+	$(HOSTCC) $(HOST_LDFLAGS) $^ -o $@
+
+# Before and after the pool: the same benchmark over ff.c with FF_NAMBUF_DEPTH 0
+HOST_NAMBUF0_OBJS := $(filter-out $(HOSTBUILD)/bdk/libs/fatfs/ff.o, $(HOST_OBJS))
+HOST_NAMBUF0_OBJS += $(HOSTBUILD)/nambuf0/ff.o $(HOSTBUILD)/nambuf0/bench_nambuf.o
+
+host-nambuf: $(HOSTBUILD)/bench_nambuf0 $(HOSTBUILD)/bench_nambuf
+	$(HOSTBUILD)/bench_nambuf0 $(HOSTBUILD)/nambuf.img
+	$(HOSTBUILD)/bench_nambuf $(HOSTBUILD)/nambuf.img
+
+$(HOSTBUILD)/bench_nambuf: $(HOST_OBJS) $(HOSTBUILD)/bench_nambuf.o
+	$(HOSTCC) $(HOST_LDFLAGS) $^ -o $@
+
+$(HOSTBUILD)/bench_nambuf0: $(HOST_NAMBUF0_OBJS)
+	$(HOSTCC) $(HOST_LDFLAGS) $^ -o $@
+
+$(HOSTBUILD)/nambuf0/ff.o: $(BDKDIR)/libs/fatfs/ff.c
+	@mkdir -p "$(@D)"
+	$(HOSTCC) $(HOST_CFLAGS) -DHOST_NAMBUF_DEPTH=0 -c $< -o $@
+
+$(HOSTBUILD)/nambuf0/bench_nambuf.o: $(HOSTDIR)/bench_nambuf.c $(HOSTDIR)/host.h
+	@mkdir -p "$(@D)"
+	$(HOSTCC) $(HOST_CFLAGS) -DHOST_NAMBUF_DEPTH=0 -c $< -o $@
+
+# zlib makes the reference streams and CRCs
+$(HOSTBUILD)/test_%: $(HOST_OBJS) $(HOSTBUILD)/test_%.o
+	$(HOSTCC) $(HOST_LDFLAGS) $^ -lz -lpthread -o $@
+
+$(HOSTBUILD)/src/%.o: $(SOURCEDIR)/%.c
+	@mkdir -p "$(@D)"
+	$(HOSTCC) $(HOST_CFLAGS) -c $< -o $@
+
+$(HOSTBUILD)/bdk/utils/util.o: $(BDKDIR)/utils/util.c
+	@mkdir -p "$(@D)"
+	$(HOSTCC) $(HOST_CFLAGS) $(HOST_UTIL_DEFINES) -c $< -o $@
+
+# ini.c lists folders with it; its sort copies between entries of one buffer,
+# which gcc flags although the entries never overlap
+$(HOSTBUILD)/bdk/utils/dirlist.o: $(BDKDIR)/utils/dirlist.c
+	@mkdir -p "$(@D)"
+	$(HOSTCC) $(HOST_CFLAGS) -Wno-restrict -c $< -o $@
+
+$(HOSTBUILD)/bdk/%.o: $(BDKDIR)/%.c
+	@mkdir -p "$(@D)"
+	$(HOSTCC) $(HOST_CFLAGS) -c $< -o $@
+
+$(HOSTBUILD)/%.o: $(HOSTDIR)/%.c $(HOSTDIR)/host.h
+	@mkdir -p "$(@D)"
+	$(HOSTCC) $(HOST_CFLAGS) -c $< -o $@
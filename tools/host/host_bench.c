@@ -0,0 +1,244 @@
+/*
+ * OmniNX Installer - Host benchmark
+ *
+ * Runs the real install (install.c and everything below it down to FatFs and
+ * the diskio write shaping) against an image file on a Linux box, so a change
+ * to the copy or delete paths can be measured before it is flashed. The image
+ * can be created and filled here, no mtools or loop mounts needed:
+ *
+ *   host-bench -s 4096 -p "OmniNX Standard" card.img    fresh FAT32 card, clean install
+ *   host-bench -p "OmniNX Standard" card.img            same card again, update install
+ *
+ * The BDK's f_mkfs has no exFAT support, exFAT images have to be made with
+ * mkfs.exfat (one MBR partition) and filled here with -p or -z.
+ *
+ * The same counters as on the console are printed at the end: time, SD
+ * commands and sectors after write shaping, erases, heap calls and the
+ * FatFs call table. Times are those of the host, the counters are the ones
+ * the card would see.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "host.h"
+#include <fs.h>
+#include <install.h>
+#include <libs/fatfs/diskio.h>
+#include <libs/fatfs/ff.h>
+#include <nx_sd.h>
+#include <sd_profile.h>
+#include <storage/sd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <version.h>
+
+// FatFs has its own DIR
+#define DIR HOST_DIR
+#include <dirent.h>
+#undef DIR
+
+#define HOST_COPY_CHUNK 0x100000
+
+extern bool sd_mounted;
+
+static u8 copy_buf[HOST_COPY_CHUNK];
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: host-bench [options] IMAGE\n"
+        "  -s MB     create IMAGE with this size and format it as FAT32\n"
+        "  -c BYTES  cluster size for -s (default: FatFs choice)\n"
+        "  -p DIR    copy the pack folder DIR (e.g. \"OmniNX Standard\") to the card root\n"
+        "  -z FILE   copy a release ZIP (OmniNX-*.zip) to the card root\n"
+        "  -a KB     allocation unit the card reports (default 4096, 0 for none)\n"
+        "  -t TIER   card profile: legacy, standard, fast, a2 (default standard)\n");
+    exit(2);
+}
+
+static int copy_host_file(const char *src, const char *dst) {
+    FIL fp;
+    UINT bw;
+    size_t n;
+    int res;
+
+    FILE *in = fopen(src, "rb");
+    if (!in)
+        return FR_NO_FILE;
+
+    res = f_open(&fp, dst, FA_WRITE | FA_CREATE_ALWAYS);
+    while (res == FR_OK && (n = fread(copy_buf, 1, sizeof(copy_buf), in)) > 0) {
+        res = f_write(&fp, copy_buf, n, &bw);
+        if (res == FR_OK && bw != n)
+            res = FR_DENIED;
+    }
+    if (res == FR_OK || fp.obj.fs)
+        f_close(&fp);
+    fclose(in);
+
+    return res;
+}
+
+static int copy_host_tree(const char *src, const char *dst) {
+    char s[1024], d[1024];
+    struct dirent *e;
+    struct stat st;
+    int res = f_mkdir(dst);
+
+    if (res != FR_OK && res != FR_EXIST)
+        return res;
+
+    HOST_DIR *dir = opendir(src);
+    if (!dir)
+        return FR_NO_PATH;
+
+    res = FR_OK;
+    while (res == FR_OK && (e = readdir(dir))) {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+            continue;
+
+        snprintf(s, sizeof(s), "%s/%s", src, e->d_name);
+        snprintf(d, sizeof(d), "%s/%s", dst, e->d_name);
+        if (stat(s, &st))
+            continue;
+        res = S_ISDIR(st.st_mode) ? copy_host_tree(s, d) : copy_host_file(s, d);
+    }
+    closedir(dir);
+
+    return res;
+}
+
+static const char *base_name(const char *path) {
+    const char *p = path + strlen(path);
+
+    while (p > path && p[-1] == '/')
+        p--;
+    while (p > path && p[-1] != '/')
+        p--;
+
+    return p;
+}
+
+// SSR values that make sd_profile_init() pick the tier
+static void set_card_tier(const char *tier) {
+    sd_ssr_t *ssr = &sd_storage.ssr;
+
+    sd_storage.has_sector_access = 1;
+    sd_storage.scr.sda_vsn = SCR_SPEC_VER_2;
+    memset(ssr, 0, sizeof(*ssr));
+
+    if (!strcmp(tier, "legacy"))
+        ssr->speed_class = 4;
+    else if (!strcmp(tier, "standard"))
+        ssr->uhs_grade = 1;
+    else if (!strcmp(tier, "fast"))
+        ssr->uhs_grade = 3;
+    else if (!strcmp(tier, "a2"))
+        ssr->app_class = 2;
+    else
+        usage();
+}
+
+int main(int argc, char **argv) {
+    const char *pack_dir = NULL;
+    const char *zip_file = NULL;
+    const char *tier = "standard";
+    u32 size_mb = 0, cluster = 0, au_kb = 4096;
+    int opt, res;
+
+    while ((opt = getopt(argc, argv, "s:c:p:z:a:t:")) != -1) {
+        switch (opt) {
+        case 's': size_mb = strtoul(optarg, NULL, 0); break;
+        case 'c': cluster = strtoul(optarg, NULL, 0); break;
+        case 'p': pack_dir = optarg; break;
+        case 'z': zip_file = optarg; break;
+        case 'a': au_kb = strtoul(optarg, NULL, 0); break;
+        case 't': tier = optarg; break;
+        default: usage();
+        }
+    }
+    if (optind != argc - 1)
+        usage();
+
+    const char *image = argv[optind];
+    if (size_mb && !host_sd_create(image, (u64)size_mb << 20)) {
+        perror(image);
+        return 1;
+    }
+    if (!host_sd_open(image, au_kb)) {
+        perror(image);
+        return 1;
+    }
+    set_card_tier(tier);
+
+    if (size_mb) {
+        res = f_mkfs("sd:", FM_FAT32, cluster, copy_buf, sizeof(copy_buf));
+        if (res != FR_OK) {
+            fprintf(stderr, "f_mkfs: %s\n", fs_error_str(res));
+            return 1;
+        }
+    }
+
+    res = f_mount(&sd_fs, "sd:", 1);
+    if (res != FR_OK) {
+        fprintf(stderr, "mount: %s\n", fs_error_str(res));
+        return 1;
+    }
+
+    if (pack_dir || zip_file) {
+        char dst[300];
+        if (pack_dir) {
+            snprintf(dst, sizeof(dst), "sd:/%s", base_name(pack_dir));
+            res = copy_host_tree(pack_dir, dst);
+        } else {
+            snprintf(dst, sizeof(dst), "sd:/%s", base_name(zip_file));
+            res = copy_host_file(zip_file, dst);
+        }
+        if (res != FR_OK) {
+            fprintf(stderr, "copy to %s: %s\n", dst, fs_error_str(res));
+            return 1;
+        }
+
+        // Start the install from a cold mount, as after a reboot
+        disk_ioctl(DRIVE_SD, CTRL_SYNC, NULL);
+        f_mount(NULL, "sd:", 1);
+        f_mount(&sd_fs, "sd:", 1);
+    }
+
+    sd_mounted = true;
+    sd_profile_init();
+
+    omninx_status_t current = detect_omninx_installation();
+    omninx_variant_t pack_variant = detect_pack_variant();
+    if (pack_variant == VARIANT_NONE) {
+        fprintf(stderr, "No OmniNX pack on the card\n");
+        return 1;
+    }
+    install_mode_t mode = current.is_installed ? INSTALL_MODE_UPDATE : INSTALL_MODE_CLEAN;
+
+    printf("Pack: %s, %s install, card profile %s, AU %d KB\n\n", get_variant_name(pack_variant),
+        mode == INSTALL_MODE_UPDATE ? "update" : "clean", sd_profile_get()->name, au_kb);
+
+    u32 heap_calls = host_heap_calls();
+    res = perform_installation(pack_variant, mode);
+    heap_calls = host_heap_calls() - heap_calls;
+
+    install_show_stats();
+    host_gfx_flush();
+
+    DSTATS d;
+    disk_get_stats(&d);
+    printf("\nResult: %s\n", fs_error_str(res));
+    printf("SD reads:  %u cmds, %u sectors\n", d.rd_cmds, d.rd_sectors);
+    printf("SD writes: %u cmds, %u sectors\n", d.wr_cmds, d.wr_sectors);
+    printf("SD erases: %u cmds\n", d.erase_cmds);
+    printf("Heap:      %u calls, %u KB in use\n", heap_calls, host_heap_used() >> 10);
+
+    sd_cache_flush();
+    f_mount(NULL, "sd:", 1);
+    host_sd_close();
+
+    return res == FR_OK ? 0 : 1;
+}
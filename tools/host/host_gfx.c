@@ -0,0 +1,181 @@
+/*
+ * OmniNX Installer - Host build: console on stdout
+ *
+ * Same format subset and cursor model as source/gfx.c: x is the line (16 per
+ * line), y runs from YLEFT down as characters are printed. Lines are kept in
+ * a buffer and written out at the newline, so a progress line that is redrawn
+ * in place shows up once, in its final state.
+ */
+
+#include "host.h"
+#include <gfx.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HOST_COLS ((YLEFT + 1) / 16)
+
+gfx_ctxt_t gfx_ctxt;
+gfx_con_t gfx_con = { .fntsz = 16, .y = YLEFT };
+
+static char line[HOST_COLS + 1];
+static u32 line_len;
+
+static void host_flush_line(void) {
+    line[line_len] = 0;
+    puts(line);
+    line_len = 0;
+}
+
+void gfx_clear_grey(u8 color) {
+    if (line_len)
+        host_flush_line();
+}
+
+void gfx_con_setcol(u32 fgcol, int fillbg, u32 bgcol) {
+    gfx_con.fgcol = fgcol;
+    gfx_con.fillbg = fillbg;
+    gfx_con.bgcol = bgcol;
+}
+
+void gfx_con_getpos(u32 *x, u32 *y) {
+    *x = gfx_con.x;
+    *y = gfx_con.y;
+}
+
+void gfx_con_setpos(u32 x, u32 y) {
+    // Moving to another line ends the current one
+    if (x != gfx_con.x && line_len)
+        host_flush_line();
+
+    gfx_con.x = x;
+    gfx_con.y = y;
+}
+
+void gfx_putc(char c) {
+    if (c == '\n') {
+        host_flush_line();
+        gfx_con.x += 16;
+        gfx_con.y = YLEFT;
+        return;
+    }
+
+    u32 col = (YLEFT - gfx_con.y) / 16;
+    if (col < HOST_COLS) {
+        while (line_len < col)
+            line[line_len++] = ' ';
+        line[col] = c;
+        if (col == line_len)
+            line_len++;
+    }
+    if (gfx_con.y >= 16)
+        gfx_con.y -= 16;
+}
+
+void gfx_puts(const char *s) {
+    while (s && *s)
+        gfx_putc(*s++);
+}
+
+static void host_putn(u32 v, int base, char fill, int fcnt) {
+    char buf[65];
+    static const char digits[] = "0123456789ABCDEF";
+    char *p;
+    int c = fcnt;
+
+    if (base > 36)
+        return;
+
+    p = buf + 64;
+    *p = 0;
+    do {
+        c--;
+        *--p = digits[v % base];
+        v /= base;
+    } while (v);
+
+    if (fill != 0) {
+        while (c > 0) {
+            *--p = fill;
+            c--;
+        }
+    }
+
+    gfx_puts(p);
+}
+
+void gfx_vprintf(const char *fmt, va_list ap) {
+    int fill, fcnt;
+
+    while (*fmt) {
+        if (*fmt == '%') {
+            fmt++;
+            fill = 0;
+            fcnt = 0;
+            if ((*fmt >= '0' && *fmt <= '9') || *fmt == ' ') {
+                fcnt = *fmt;
+                fmt++;
+                if (*fmt >= '0' && *fmt <= '9') {
+                    fill = fcnt;
+                    fcnt = *fmt - '0';
+                    fmt++;
+                } else {
+                    fill = ' ';
+                    fcnt -= '0';
+                }
+            }
+            switch (*fmt) {
+            case 'c':
+                gfx_putc(va_arg(ap, u32));
+                break;
+            case 's':
+                gfx_puts(va_arg(ap, char *));
+                break;
+            case 'd':
+                host_putn(va_arg(ap, u32), 10, fill, fcnt);
+                break;
+            case 'p':
+            case 'P':
+            case 'x':
+            case 'X':
+                host_putn(va_arg(ap, u32), 16, fill, fcnt);
+                break;
+            case 'k':
+                gfx_con.fgcol = va_arg(ap, u32);
+                break;
+            case 'K':
+                gfx_con.bgcol = va_arg(ap, u32);
+                break;
+            case '%':
+                gfx_putc('%');
+                break;
+            case '\0':
+                return;
+            default:
+                gfx_putc('%');
+                gfx_putc(*fmt);
+                break;
+            }
+        } else {
+            gfx_putc(*fmt);
+        }
+        fmt++;
+    }
+}
+
+void gfx_printf(const char *fmt, ...) {
+    va_list ap;
+
+    if (gfx_con.mute)
+        return;
+
+    va_start(ap, fmt);
+    gfx_vprintf(fmt, ap);
+    va_end(ap);
+}
+
+// Whatever is left of the last line
+void host_gfx_flush(void) {
+    if (line_len)
+        host_flush_line();
+    fflush(stdout);
+}
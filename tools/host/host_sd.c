@@ -0,0 +1,100 @@
+/*
+ * OmniNX Installer - Host build: SD card backed by an image file
+ *
+ * Only the sdmmc calls below diskio are replaced. The write shaping, TRIM
+ * queue and transfer counters of source/libs/fatfs/diskio.c run unchanged on
+ * top, so the DSTATS of a host run are the ones the card would see.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "host.h"
+#include <nx_sd.h>
+#include <storage/sdmmc.h>
+#include <stdio.h>
+
+#define HOST_PART_START 0x8000
+
+static FILE *img;
+static u32 sd_au_kb;
+
+bool host_sd_create(const char *path, u64 size) {
+    if (size >> 9 <= HOST_PART_START * 2)
+        return false;
+
+    FILE *fp = fopen(path, "r+b");
+    if (!fp)
+        fp = fopen(path, "w+b");
+    if (!fp)
+        return false;
+
+    // One FAT32 (LBA) partition at 16MB, like hekate partitions a card
+    u8 mbr[512] = { 0 };
+    u32 start = HOST_PART_START;
+    u32 count = (u32)(size >> 9) - start;
+    mbr[0x1BE + 4] = 0x0C;
+    for (u32 i = 0; i < 4; i++) {
+        mbr[0x1BE + 8 + i] = (u8)(start >> (i * 8));
+        mbr[0x1BE + 12 + i] = (u8)(count >> (i * 8));
+    }
+    mbr[510] = 0x55;
+    mbr[511] = 0xAA;
+
+    // Sparse, only what gets written takes space
+    bool ok = fwrite(mbr, 512, 1, fp) == 1;
+    ok = ok && !fseeko(fp, (off_t)(size & ~511ULL) - 1, SEEK_SET) && fputc(0, fp) != EOF;
+    fclose(fp);
+
+    return ok;
+}
+
+bool host_sd_open(const char *path, u32 au_kb) {
+    img = fopen(path, "r+b");
+    if (!img)
+        return false;
+
+    fseeko(img, 0, SEEK_END);
+    sd_storage.sec_cnt = (u32)(ftello(img) >> 9);
+    sd_storage.initialized = 1;
+    sd_au_kb = au_kb;
+
+    return true;
+}
+
+void host_sd_close(void) {
+    if (img)
+        fclose(img);
+    img = NULL;
+}
+
+int sdmmc_storage_read(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf) {
+    if (!img || sector + num_sectors > storage->sec_cnt)
+        return 0;
+
+    fseeko(img, (off_t)sector << 9, SEEK_SET);
+    return fread(buf, 512, num_sectors, img) == num_sectors;
+}
+
+int sdmmc_storage_write(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf) {
+    if (!img || sector + num_sectors > storage->sec_cnt)
+        return 0;
+
+    fseeko(img, (off_t)sector << 9, SEEK_SET);
+    return fwrite(buf, 512, num_sectors, img) == num_sectors;
+}
+
+// The data of erased sectors is undefined on a card, the image keeps it
+int sd_storage_erase(sdmmc_storage_t *storage, u32 sector, u32 num_sectors) {
+    if (sector + num_sectors > storage->sec_cnt)
+        return 0;
+
+    return 1;
+}
+
+int sd_storage_flush_cache(sdmmc_storage_t *storage, u8 *buf) {
+    return img && !fflush(img);
+}
+
+u32 sd_storage_get_ssr_au(sdmmc_storage_t *storage) {
+    return sd_au_kb;
+}
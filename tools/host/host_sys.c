@@ -0,0 +1,244 @@
+/*
+ * OmniNX Installer - Host build: timers, heap accounting, SE and worker
+ *
+ * The payload's malloc/calloc/free are linked with --wrap, so they still go to
+ * the C library but are counted like the BDK heap counts them (node header
+ * and 32-byte rounding included). The SE SHA-256 engine is replaced by a plain
+ * C implementation with the same streaming interface, and the A57 worker by
+ * computing the CRC32 right away. BPMP cache maintenance becomes a memory
+ * barrier, which is what it stands for towards the other core.
+ */
+
+#include "host.h"
+#include <memory_map.h>
+#include <libs/fatfs/ff.h>
+#include <mem/heap.h>
+#include <sec/se.h>
+#include <soc/bpmp.h>
+#include <sec/se_t210.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <utils/util.h>
+
+#define HOST_HNODE_SIZE 32 // sizeof(hnode_t) on the BPMP
+
+/* Timers */
+
+static u64 host_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+u32 get_tmr_us(void) {
+    return (u32)(host_ns() / 1000);
+}
+
+u32 get_tmr_ms(void) {
+    return (u32)(host_ns() / 1000000);
+}
+
+u32 get_tmr_s(void) {
+    return (u32)(host_ns() / 1000000000ULL);
+}
+
+/* Heap */
+
+typedef struct {
+    u64 size;
+    u64 rsvd;
+} host_block_t;
+
+void *__real_malloc(unsigned long size);
+void __real_free(void *buf);
+
+static u32 heap_calls;
+static u32 heap_used;
+
+static u32 host_node_size(u64 size) {
+    return ALIGN((u32)size, HOST_HNODE_SIZE) + HOST_HNODE_SIZE;
+}
+
+void *__wrap_malloc(unsigned long size) {
+    heap_calls++;
+
+    host_block_t *b = __real_malloc(sizeof(host_block_t) + size);
+    if (!b)
+        return NULL;
+
+    b->size = size;
+    heap_used += host_node_size(size);
+
+    return b + 1;
+}
+
+void *__wrap_calloc(unsigned long num, unsigned long size) {
+    void *buf = __wrap_malloc(num * size);
+
+    if (buf)
+        memset(buf, 0, num * size);
+
+    return buf;
+}
+
+void __wrap_free(void *buf) {
+    heap_calls++;
+
+    if (!buf)
+        return;
+
+    host_block_t *b = (host_block_t *)buf - 1;
+    heap_used -= host_node_size(b->size);
+    __real_free(b);
+}
+
+void heap_monitor(heap_monitor_t *mon, bool print_node_stats) {
+    mon->total = IPL_HEAP_SZ;
+    mon->used = heap_used;
+    mon->calls = heap_calls;
+}
+
+u32 host_heap_calls(void) {
+    return heap_calls;
+}
+
+u32 host_heap_used(void) {
+    return heap_used;
+}
+
+/* SE SHA-256, one stream at a time like the engine */
+
+static const u32 sha256_k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static struct {
+    u32 h[8];
+    u8 blk[64];
+    u32 blk_len;
+    u64 len;
+} sha;
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(const u8 *p) {
+    u32 w[64];
+    u32 a, b, c, d, e, f, g, h;
+
+    for (u32 i = 0; i < 16; i++)
+        w[i] = (u32)p[i * 4] << 24 | (u32)p[i * 4 + 1] << 16 | (u32)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+    for (u32 i = 16; i < 64; i++) {
+        u32 s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        u32 s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = sha.h[0]; b = sha.h[1]; c = sha.h[2]; d = sha.h[3];
+    e = sha.h[4]; f = sha.h[5]; g = sha.h[6]; h = sha.h[7];
+    for (u32 i = 0; i < 64; i++) {
+        u32 t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        u32 t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    sha.h[0] += a; sha.h[1] += b; sha.h[2] += c; sha.h[3] += d;
+    sha.h[4] += e; sha.h[5] += f; sha.h[6] += g; sha.h[7] += h;
+}
+
+static void sha256_init(void) {
+    static const u32 iv[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+    };
+
+    memcpy(sha.h, iv, sizeof(iv));
+    sha.blk_len = 0;
+    sha.len = 0;
+}
+
+static void sha256_update(const u8 *p, u32 size) {
+    sha.len += size;
+    while (size) {
+        u32 n = MIN(64 - sha.blk_len, size);
+        memcpy(sha.blk + sha.blk_len, p, n);
+        sha.blk_len += n;
+        p += n;
+        size -= n;
+        if (sha.blk_len == 64) {
+            sha256_block(sha.blk);
+            sha.blk_len = 0;
+        }
+    }
+}
+
+static void sha256_final(u8 *hash) {
+    u64 bits = sha.len * 8;
+    u8 pad[72] = { 0x80 };
+    u32 pad_len = (sha.blk_len < 56 ? 56 : 120) - sha.blk_len;
+
+    for (u32 i = 0; i < 8; i++)
+        pad[pad_len + i] = (u8)(bits >> (56 - i * 8));
+    sha256_update(pad, pad_len + 8);
+
+    for (u32 i = 0; i < 8; i++) {
+        hash[i * 4]     = (u8)(sha.h[i] >> 24);
+        hash[i * 4 + 1] = (u8)(sha.h[i] >> 16);
+        hash[i * 4 + 2] = (u8)(sha.h[i] >> 8);
+        hash[i * 4 + 3] = (u8)sha.h[i];
+    }
+}
+
+int se_calc_sha256(void *hash, u32 *msg_left, const void *src, u32 src_size, u64 total_size, u32 sha_cfg, bool is_oneshot) {
+    if (sha_cfg == SHA_INIT_HASH)
+        sha256_init();
+
+    sha256_update(src, src_size);
+    if (is_oneshot)
+        sha256_final(hash);
+
+    return 1;
+}
+
+int se_calc_sha256_finalize(void *hash, u32 *msg_left) {
+    sha256_final(hash);
+
+    return 1;
+}
+
+int se_calc_sha256_oneshot(void *hash, const void *src, u32 src_size) {
+    return se_calc_sha256(hash, NULL, src, src_size, src_size, SHA_INIT_HASH, true);
+}
+
+/* BPMP cache */
+
+void bpmp_mmu_maintenance(u32 op, bool force) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Invalidates are what a poll loop does, let the other side run on one core
+    if (op == BPMP_MMU_MAINT_INVALID_WAY)
+        sched_yield();
+}
+
+/* A57 worker */
+
+static u32 worker_crc;
+
+void worker_crc32_begin(u32 crc, const void *buf, u32 size) {
+    worker_crc = crc32_calc(crc, buf, size);
+}
+
+u32 worker_crc32_end(void) {
+    return worker_crc;
+}
+
+/* FatFs FAT cache, see ffconf_host.h */
+
+unsigned char host_fat_cache[FF_FAT_CACHE_SZ] __attribute__((aligned(64)));
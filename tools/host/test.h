@@ -0,0 +1,57 @@
+/*
+ * OmniNX Installer - Host tests
+ *
+ * What the tools/host/test_*.c programs share: check() counts results and
+ * prints the failed ones, rnd() is a xorshift generator (each test defines
+ * TEST_SEED before including this), test_report() prints the count line.
+ */
+
+#pragma once
+#include "host.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+// util.c is built with its timers renamed (host.mk), unistd.h has its own usleep
+#define usleep bdk_usleep
+#include <utils/util.h>
+#undef usleep
+
+static u32 failed;
+static u32 passed;
+static u32 rnd_state = TEST_SEED;
+
+static inline u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+// Count a check, print "FAIL: " and the formatted message if it failed
+static void __attribute__((format(printf, 2, 3))) check(bool ok, const char *fmt, ...) {
+    va_list ap;
+
+    if (ok) {
+        passed++;
+        return;
+    }
+
+    failed++;
+    printf("FAIL: ");
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+}
+
+// Print the formatted prefix and "N checks, N failed". Returns the exit code.
+static int __attribute__((format(printf, 1, 2))) test_report(const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("%d checks, %d failed\n", passed + failed, failed);
+
+    return failed ? 1 : 0;
+}
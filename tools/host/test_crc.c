@@ -0,0 +1,140 @@
+/*
+ * OmniNX Installer - Host test: CRC32 and CRC16
+ *
+ * crc32_calc() (slice-by-4) against the check value and zlib, at every
+ * alignment and split into pieces. crc16_calc() against the nibble-table
+ * version it replaced, which is kept here as the reference. Prints the
+ * throughput of the old and new versions; the numbers are the host's, only
+ * the ratio says something about the BPMP.
+ */
+
+#define TEST_SEED 0x2545F491
+
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#define BENCH_SIZE (16 * SZ_1M)
+#define BENCH_REPS 8
+
+/* The versions before the table rework */
+
+static u16 crc16_nibble(const u8 *buf, u32 len) {
+    static const u16 table[16] = {
+        0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+        0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+    };
+    u16 crc = 0x55aa;
+
+    for (const u8 *q = buf + len; buf < q; buf++) {
+        crc = (crc >> 4) ^ table[crc & 0xf] ^ table[*buf & 0xf];
+        crc = (crc >> 4) ^ table[crc & 0xf] ^ table[*buf >> 4];
+    }
+
+    return crc;
+}
+
+static u32 crc32_bytewise(u32 crc, const u8 *buf, u32 len) {
+    static u32 table[256];
+
+    if (!table[1]) {
+        for (u32 i = 0; i < 256; i++) {
+            u32 rem = i;
+            for (u32 j = 0; j < 8; j++)
+                rem = rem & 1 ? (rem >> 1) ^ 0xedb88320 : rem >> 1;
+            table[i] = rem;
+        }
+    }
+
+    crc = ~crc;
+    for (const u8 *q = buf + len; buf < q; buf++)
+        crc = (crc >> 8) ^ table[(crc & 0xff) ^ *buf];
+
+    return ~crc;
+}
+
+/* Tests */
+
+static void test_values(void) {
+    static const u8 check_str[] = "123456789";
+    u8 *buf = malloc(4096 + 8);
+
+    for (u32 i = 0; i < 4096 + 8; i++)
+        buf[i] = (u8)rnd();
+
+    check(crc32_calc(0, check_str, 9) == 0xCBF43926, "crc32 check value");
+    check(crc32_calc(0, buf, 0) == 0, "crc32 of nothing");
+    check(crc16_calc(check_str, 9) == crc16_nibble(check_str, 9), "crc16 check string");
+
+    // Every alignment and the short tails around the word loop
+    for (u32 ofs = 0; ofs < 8; ofs++) {
+        for (u32 len = 0; len <= 4096; len = len < 64 ? len + 1 : len * 2 + 3) {
+            const u8 *p = buf + ofs;
+
+            check(crc32_calc(0, p, len) == (u32)crc32(0, p, len), "crc32 vs zlib, %d bytes at offset %d", len, ofs);
+            check(crc16_calc(p, len) == crc16_nibble(p, len), "crc16 vs nibble table, %d bytes at offset %d", len, ofs);
+
+            // Continued over pieces, as the copy loop and the A57 worker do
+            u32 cut = len ? rnd() % len : 0;
+            check(crc32_calc(crc32_calc(0, p, cut), p + cut, len - cut) == (u32)crc32(0, p, len),
+                "crc32 in two pieces, %d bytes at offset %d", len, ofs);
+            check(crc16_update(crc16_calc(p, cut), p + cut, len - cut) == crc16_nibble(p, len),
+                "crc16 in two pieces, %d bytes at offset %d", len, ofs);
+        }
+    }
+
+    free(buf);
+}
+
+static double bench(const char *name, u32 (*fn)(const u8 *, u32), const u8 *buf, double base) {
+    struct timespec t0, t1;
+    volatile u32 sink = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (u32 i = 0; i < BENCH_REPS; i++)
+        sink += fn(buf + (i & 3), BENCH_SIZE - 4);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    double mbs = (double)BENCH_REPS * BENCH_SIZE / SZ_1M / s;
+    if (base > 0)
+        printf("  %-22s %8.0f MB/s  x%.1f\n", name, mbs, mbs / base);
+    else
+        printf("  %-22s %8.0f MB/s\n", name, mbs);
+    (void)sink;
+
+    return mbs;
+}
+
+static u32 run_crc32_calc(const u8 *buf, u32 len) { return crc32_calc(0, buf, len); }
+static u32 run_crc32_bytewise(const u8 *buf, u32 len) { return crc32_bytewise(0, buf, len); }
+static u32 run_crc32_zlib(const u8 *buf, u32 len) { return crc32(0, buf, len); }
+static u32 run_crc16_calc(const u8 *buf, u32 len) { return crc16_calc(buf, len); }
+static u32 run_crc16_nibble(const u8 *buf, u32 len) { return crc16_nibble(buf, len); }
+
+static void test_throughput(void) {
+    u8 *buf = malloc(BENCH_SIZE);
+
+    for (u32 i = 0; i < BENCH_SIZE; i++)
+        buf[i] = (u8)rnd();
+
+    printf("Throughput (host, %d x %d MB):\n", BENCH_REPS, BENCH_SIZE / SZ_1M);
+    double base = bench("crc32 byte table (old)", run_crc32_bytewise, buf, 0);
+    bench("crc32_calc", run_crc32_calc, buf, base);
+    bench("zlib crc32", run_crc32_zlib, buf, base);
+    base = bench("crc16 nibble (old)", run_crc16_nibble, buf, 0);
+    bench("crc16_calc", run_crc16_calc, buf, base);
+
+    free(buf);
+}
+
+int main(int argc, char **argv) {
+    test_values();
+    int res = test_report("CRC: ");
+    test_throughput();
+
+    return res;
+}
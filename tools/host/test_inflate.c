@@ -0,0 +1,558 @@
+/*
+ * OmniNX Installer - Host test: DEFLATE decoder and ZIP install
+ *
+ * source/inflate.c against raw DEFLATE streams made by zlib: stored, fixed and
+ * dynamic Huffman blocks, Huffman-only and RLE, streams with sync flushes and
+ * strategy changes in between (mixed block types), matches at the maximum
+ * distance and length. The input reaches the decoder in ragged chunks and
+ * the output window is the minimum 64KB, so block, refill and window
+ * boundaries all fall at odd places. Size, CRC32 and every byte are checked.
+ *
+ * Then zip.c: an archive (generated, or release ZIPs given on the command
+ * line) is copied to a fresh FAT32 image and extracted like an install does.
+ * Every extracted file is compared byte for byte with what zlib decodes from
+ * the archive, using a separate central directory reader.
+ *
+ *   test_inflate IMAGE [OmniNX-*.zip ...]
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#define TEST_SEED 0x12345678
+
+#include "test.h"
+#include <inflate.h>
+#include <libs/fatfs/ff.h>
+#include <nx_sd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zip.h>
+#include <zlib.h>
+
+#define TEST_IN_SIZE  0x1000
+#define TEST_OUT_SIZE 0x10000
+#define TEST_IMG_MIN  (1ULL << 30)
+
+extern bool sd_mounted;
+
+/* Test data */
+
+typedef enum {
+    DATA_ZEROS,
+    DATA_RANDOM,
+    DATA_TEXT,
+    DATA_FAR,   // Second half repeats at exactly 32KB
+    DATA_RUNS,  // Long runs, matches of the maximum length
+} data_kind_t;
+
+static const char *data_names[] = { "zeros", "random", "text", "far", "runs" };
+
+static u8 *make_data(data_kind_t kind, u32 size) {
+    static const char *words[] = {
+        "atmosphere ", "bootloader ", "payload ", "switch ", "config ", "sysmodule ",
+        "hekate ", "OmniNX ", "\n", "0100000000000034 ", "exefs ", "romfs "
+    };
+    u8 *buf = malloc(size + 1);
+
+    for (u32 i = 0; i < size;) {
+        switch (kind) {
+        case DATA_ZEROS:
+            buf[i++] = 0;
+            break;
+        case DATA_RANDOM:
+            buf[i++] = (u8)rnd();
+            break;
+        case DATA_TEXT: {
+            const char *w = words[rnd() % 12];
+            while (*w && i < size)
+                buf[i++] = *w++;
+            break;
+        }
+        case DATA_FAR:
+            buf[i] = i >= 0x8000 && (rnd() & 63) ? buf[i - 0x8000] : (u8)rnd();
+            i++;
+            break;
+        case DATA_RUNS: {
+            u8 c = (u8)rnd();
+            for (u32 n = rnd() % 1000; n && i < size; n--)
+                buf[i++] = c;
+            break;
+        }
+        }
+    }
+
+    return buf;
+}
+
+/* Raw DEFLATE streams */
+
+typedef enum {
+    ENC_STORED,
+    ENC_FIXED,
+    ENC_DYNAMIC,
+    ENC_BEST,
+    ENC_HUFFMAN,
+    ENC_RLE,
+    ENC_FLUSHED, // Sync flushes every 10000 bytes, empty stored blocks included
+    ENC_MIXED,   // Level and strategy change every 20000 bytes
+} enc_kind_t;
+
+static const char *enc_names[] = { "stored", "fixed", "dynamic", "best", "huffman", "rle", "flushed", "mixed" };
+
+static u8 *deflate_raw(enc_kind_t kind, const u8 *src, u32 size, u32 *out_size) {
+    static const int params[][2] = {
+        { 0, Z_DEFAULT_STRATEGY }, { 6, Z_FIXED }, { 6, Z_DEFAULT_STRATEGY }, { 9, Z_DEFAULT_STRATEGY },
+        { 6, Z_HUFFMAN_ONLY }, { 6, Z_RLE }, { 6, Z_DEFAULT_STRATEGY }, { 1, Z_DEFAULT_STRATEGY }
+    };
+    z_stream z = { 0 };
+    u32 cap = deflateBound(&z, size) + size / 8 + 1024;
+    u8 *dst = malloc(cap);
+    u32 step = kind == ENC_FLUSHED ? 10000 : kind == ENC_MIXED ? 20000 : size;
+    u32 pos = 0, n = 0;
+
+    deflateInit2(&z, params[kind][0], Z_DEFLATED, -15, 8, params[kind][1]);
+    z.next_out = dst;
+    z.avail_out = cap;
+
+    do {
+        u32 len = MIN(step, size - pos);
+        z.next_in = (u8 *)src + pos;
+        z.avail_in = len;
+        pos += len;
+
+        if (kind == ENC_MIXED) {
+            static const int mix[][2] = { { 0, Z_DEFAULT_STRATEGY }, { 6, Z_FIXED }, { 9, Z_DEFAULT_STRATEGY }, { 6, Z_RLE } };
+            deflateParams(&z, mix[n % 4][0], mix[n % 4][1]);
+            n++;
+        }
+        deflate(&z, pos == size ? Z_FINISH : kind == ENC_FLUSHED ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+    } while (pos < size);
+
+    *out_size = cap - z.avail_out;
+    deflateEnd(&z);
+
+    return dst;
+}
+
+typedef struct {
+    const u8 *in;
+    u32 in_size;
+    u32 in_pos;
+    const u8 *ref;
+    u32 ref_size;
+    u32 out_pos;
+    bool mismatch;
+} stream_ctx_t;
+
+// Ragged input: 1 byte up to the full request
+static int test_read(void *ctx, u8 *buf, u32 size, u32 *read) {
+    stream_ctx_t *c = ctx;
+    u32 n = MIN(size, c->in_size - c->in_pos);
+
+    if (n > 1 && (rnd() & 3))
+        n = 1 + rnd() % n;
+    memcpy(buf, c->in + c->in_pos, n);
+    c->in_pos += n;
+    *read = n;
+
+    return 0;
+}
+
+static int test_write(void *ctx, const u8 *buf, u32 size) {
+    stream_ctx_t *c = ctx;
+
+    if (c->out_pos + size > c->ref_size || memcmp(c->ref + c->out_pos, buf, size))
+        c->mismatch = true;
+    c->out_pos += size;
+
+    return c->mismatch;
+}
+
+static void test_stream(inflate_t *inf, enc_kind_t enc, data_kind_t data, u32 size) {
+    char name[64];
+    u32 csize;
+
+    snprintf(name, sizeof(name), "%s %s %d", enc_names[enc], data_names[data], size);
+
+    u8 *ref = make_data(data, size);
+    u8 *comp = deflate_raw(enc, ref, size, &csize);
+    stream_ctx_t c = { comp, csize, 0, ref, size, 0, false };
+
+    int res = inflate_stream(inf, test_read, test_write, &c);
+    check(res == INFLATE_OK, "%s: decode error", name);
+    check(!c.mismatch && c.out_pos == size, "%s: output differs", name);
+    check(inf->pos == size, "%s: size", name);
+    check(inf->crc == (u32)crc32(0, ref, size), "%s: crc32", name);
+
+    // A cut stream has to fail, not hang or run past the input
+    if (csize > 2) {
+        stream_ctx_t t = { comp, csize / 2, 0, ref, size, 0, false };
+        res = inflate_stream(inf, test_read, test_write, &t);
+        check(res != INFLATE_OK || t.mismatch, "%s: truncated stream accepted", name);
+    }
+
+    free(comp);
+    free(ref);
+}
+
+// Flipped bits must end in an error or a wrong CRC, and never overrun
+static void test_corrupt(inflate_t *inf) {
+    u32 size = 200000, csize;
+    u8 *ref = make_data(DATA_TEXT, size);
+    u8 *comp = deflate_raw(ENC_DYNAMIC, ref, size, &csize);
+    u8 *bad = malloc(csize);
+    u32 caught = 0;
+
+    for (u32 i = 0; i < 500; i++) {
+        memcpy(bad, comp, csize);
+        bad[rnd() % csize] ^= 1 << (rnd() & 7);
+
+        stream_ctx_t c = { bad, csize, 0, ref, size, 0, false };
+        int res = inflate_stream(inf, test_read, test_write, &c);
+        if (res != INFLATE_OK || c.mismatch || inf->crc != (u32)crc32(0, ref, size))
+            caught++;
+    }
+    // A flip in the last bits of the final block can go unnoticed
+    check(caught >= 490, "corrupt dynamic text: corruption not detected");
+
+    u8 invalid = 0x07; // Final block of the reserved type 3
+    stream_ctx_t c = { &invalid, 1, 0, ref, size, 0, false };
+    check(inflate_stream(inf, test_read, test_write, &c) == INFLATE_ERR_DATA, "invalid: block type 3");
+
+    free(bad);
+    free(comp);
+    free(ref);
+}
+
+static void test_streams(void) {
+    static const u32 sizes[] = { 0, 1, 100, 0xFFFF, 0x10000, 0x10001, 300000, 3000000 };
+    inflate_t inf;
+
+    if (inflate_init(&inf, TEST_IN_SIZE, TEST_OUT_SIZE) != INFLATE_OK) {
+        check(false, "streams: inflate_init");
+        return;
+    }
+
+    for (u32 e = ENC_STORED; e <= ENC_MIXED; e++)
+        for (u32 d = DATA_ZEROS; d <= DATA_RUNS; d++)
+            for (u32 s = 0; s < ARRAY_SIZE(sizes); s++)
+                test_stream(&inf, e, d, sizes[s]);
+    test_corrupt(&inf);
+
+    inflate_end(&inf);
+}
+
+/* ZIP archives */
+
+typedef struct {
+    char name[256];
+    u32 method;
+    u32 crc;
+    u32 csize;
+    u32 usize;
+    u32 lho;
+} ref_entry_t;
+
+static void wr16(u8 *p, u32 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void wr32(u8 *p, u32 v) {
+    wr16(p, v);
+    wr16(p + 2, v >> 16);
+}
+
+static u32 rd16(const u8 *p) {
+    return p[0] | p[1] << 8;
+}
+
+static u32 rd32(const u8 *p) {
+    return rd16(p) | rd16(p + 2) << 16;
+}
+
+// A pack the way the release is zipped, stored and deflated entries mixed
+static bool make_zip(const char *path) {
+    static const char *files[] = {
+        "OmniNX Standard/",
+        "OmniNX Standard/config/omninx/manifest.ini",
+        "OmniNX Standard/atmosphere/package3",
+        "OmniNX Standard/atmosphere/contents/0100000000000034/exefs.nsp",
+        "OmniNX Standard/atmosphere/contents/0100000000000034/flags/boot2.flag",
+        "OmniNX Standard/bootloader/",
+        "OmniNX Standard/bootloader/hekate_ipl.ini",
+        "OmniNX Standard/bootloader/payloads/OmniNX-Installer.bin",
+        "OmniNX Standard/switch/tool/tool.nro",
+        "OmniNX Standard/switch/tool/README.txt",
+    };
+    static const char manifest[] = "[OmniNX]\ncurrent_pack=standard\nversion=1.0.0\n";
+    u8 cd[16384], hdr[30];
+    u32 cd_len = 0, ofs = 0;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return false;
+
+    for (u32 i = 0; i < ARRAY_SIZE(files); i++) {
+        const char *name = files[i];
+        u32 name_len = strlen(name);
+        bool dir = name[name_len - 1] == '/';
+        u32 size = dir ? 0 : i == 1 ? sizeof(manifest) - 1 : i == 4 ? 0 : rnd() % 3000000;
+        u8 *data = make_data(i % 5, size);
+        if (i == 1)
+            memcpy(data, manifest, size);
+        u32 method = dir || i % 4 == 3 ? 0 : 8;
+        u32 csize = size;
+        u8 *comp = data;
+
+        if (method == 8)
+            comp = deflate_raw(i % 3 ? ENC_DYNAMIC : ENC_MIXED, data, size, &csize);
+
+        memset(hdr, 0, sizeof(hdr));
+        wr32(hdr, 0x04034B50);
+        wr16(hdr + 4, 20);
+        wr16(hdr + 8, method);
+        wr32(hdr + 14, crc32(0, data, size));
+        wr32(hdr + 18, csize);
+        wr32(hdr + 22, size);
+        wr16(hdr + 26, name_len);
+        fwrite(hdr, 1, 30, fp);
+        fwrite(name, 1, name_len, fp);
+        fwrite(comp, 1, csize, fp);
+
+        u8 *c = cd + cd_len;
+        memset(c, 0, 46);
+        wr32(c, 0x02014B50);
+        wr16(c + 4, 20);
+        wr16(c + 6, 20);
+        memcpy(c + 8, hdr + 6, 24);
+        wr32(c + 42, ofs);
+        memcpy(c + 46, name, name_len);
+        cd_len += 46 + name_len;
+        ofs += 30 + name_len + csize;
+
+        if (comp != data)
+            free(comp);
+        free(data);
+    }
+
+    u8 eocd[22] = { 0 };
+    wr32(eocd, 0x06054B50);
+    wr16(eocd + 8, ARRAY_SIZE(files));
+    wr16(eocd + 10, ARRAY_SIZE(files));
+    wr32(eocd + 12, cd_len);
+    wr32(eocd + 16, ofs);
+    fwrite(cd, 1, cd_len, fp);
+    fwrite(eocd, 1, 22, fp);
+
+    return !fclose(fp);
+}
+
+static ref_entry_t *read_central(FILE *fp, u32 *count, u64 *total) {
+    u8 tail[0x10000 + 22];
+
+    fseeko(fp, 0, SEEK_END);
+    u64 fsize = ftello(fp);
+    u32 search = MIN(fsize, sizeof(tail));
+    fseeko(fp, fsize - search, SEEK_SET);
+    if (fread(tail, 1, search, fp) != search)
+        return NULL;
+
+    u8 *eocd = NULL;
+    for (u32 i = search - 22 + 1; i-- > 0 && !eocd;)
+        if (rd32(tail + i) == 0x06054B50)
+            eocd = tail + i;
+    if (!eocd)
+        return NULL;
+
+    u32 n = rd16(eocd + 10), cd_size = rd32(eocd + 12);
+    u8 *cd = malloc(cd_size);
+    fseeko(fp, rd32(eocd + 16), SEEK_SET);
+    if (fread(cd, 1, cd_size, fp) != cd_size) {
+        free(cd);
+        return NULL;
+    }
+
+    ref_entry_t *ents = calloc(n, sizeof(ref_entry_t));
+    *total = 0;
+    for (u32 i = 0, p = 0; i < n; i++) {
+        const u8 *c = cd + p;
+        u32 name_len = MIN(rd16(c + 28), 255);
+        ents[i].method = rd16(c + 10);
+        ents[i].crc = rd32(c + 16);
+        ents[i].csize = rd32(c + 20);
+        ents[i].usize = rd32(c + 24);
+        ents[i].lho = rd32(c + 42);
+        memcpy(ents[i].name, c + 46, name_len);
+        *total += ents[i].usize;
+        p += 46 + rd16(c + 28) + rd16(c + 30) + rd16(c + 32);
+    }
+    free(cd);
+    *count = n;
+
+    return ents;
+}
+
+static u8 *read_entry_zlib(FILE *fp, const ref_entry_t *e) {
+    u8 lh[30];
+
+    fseeko(fp, e->lho, SEEK_SET);
+    if (fread(lh, 1, 30, fp) != 30)
+        return NULL;
+    fseeko(fp, e->lho + 30 + rd16(lh + 26) + rd16(lh + 28), SEEK_SET);
+
+    u8 *comp = malloc(e->csize + 1);
+    u8 *data = malloc(e->usize + 1);
+    if (fread(comp, 1, e->csize, fp) != e->csize) {
+        free(comp);
+        free(data);
+        return NULL;
+    }
+
+    if (e->method == 0) {
+        memcpy(data, comp, e->usize);
+    } else {
+        z_stream z = { 0 };
+        inflateInit2(&z, -15);
+        z.next_in = comp;
+        z.avail_in = e->csize;
+        z.next_out = data;
+        z.avail_out = e->usize;
+        inflate(&z, Z_FINISH);
+        inflateEnd(&z);
+    }
+    free(comp);
+
+    return data;
+}
+
+static u8 *read_sd_file(const char *path, u32 *size) {
+    FIL fp;
+    UINT br;
+
+    if (f_open(&fp, path, FA_READ) != FR_OK)
+        return NULL;
+
+    *size = f_size(&fp);
+    u8 *buf = malloc(*size + 1);
+    if (f_read(&fp, buf, *size, &br) != FR_OK || br != *size) {
+        free(buf);
+        buf = NULL;
+    }
+    f_close(&fp);
+
+    return buf;
+}
+
+static bool copy_to_sd(const char *src, const char *dst) {
+    static u8 buf[0x100000];
+    FIL fp;
+    UINT bw;
+    size_t n;
+    bool ok = true;
+
+    FILE *in = fopen(src, "rb");
+    if (!in || f_open(&fp, dst, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+        return false;
+    while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+        ok = f_write(&fp, buf, n, &bw) == FR_OK && bw == n;
+    f_close(&fp);
+    fclose(in);
+
+    return ok;
+}
+
+static void test_zip(const char *image, const char *path) {
+    static u8 work[0x100000];
+    u32 count, sel_count, checked = 0;
+    u64 total, sel_bytes;
+    omninx_variant_t variant;
+
+    FILE *fp = fopen(path, "rb");
+    ref_entry_t *ents = fp ? read_central(fp, &count, &total) : NULL;
+    if (!ents) {
+        check(false, "%s: can't read the archive", path);
+        if (fp)
+            fclose(fp);
+        return;
+    }
+
+    fseeko(fp, 0, SEEK_END);
+    u64 img_size = MAX(TEST_IMG_MIN, (u64)ftello(fp) + total * 2);
+    remove(image);
+    if (!host_sd_create(image, img_size) || !host_sd_open(image, 4096) ||
+        f_mkfs("sd:", FM_FAT32, 0, work, sizeof(work)) != FR_OK ||
+        f_mount(&sd_fs, "sd:", 1) != FR_OK) {
+        check(false, "%s: can't set up the image", path);
+        fclose(fp);
+        free(ents);
+        return;
+    }
+    sd_mounted = true;
+
+    check(copy_to_sd(path, "sd:/OmniNX-test.zip"), "%s: copy to the image", path);
+    const char *zip_path = zip_find(&variant);
+    check(zip_path != NULL, "%s: zip_find", path);
+    if (zip_path) {
+        check(zip_open(zip_path, variant, NULL, NULL, &sel_count, &sel_bytes) == FR_OK, "%s: zip_open", path);
+        check(zip_extract("sd:/") == FR_OK, "%s: zip_extract", path);
+        zip_close();
+
+        // Everything below the pack folder has to be on the card, exactly as zlib decodes it
+        const char *top = get_staging_path(variant) + 4;
+        u32 top_len = strlen(top);
+        for (u32 i = 0; i < count; i++) {
+            const ref_entry_t *e = &ents[i];
+            char dst[300];
+            u32 size;
+
+            if (strncmp(e->name, top, top_len) || e->name[top_len] != '/' || !e->name[top_len + 1])
+                continue;
+            if (e->name[strlen(e->name) - 1] == '/')
+                continue;
+
+            snprintf(dst, sizeof(dst), "sd:/%s", e->name + top_len + 1);
+            u8 *ref = read_entry_zlib(fp, e);
+            u8 *got = read_sd_file(dst, &size);
+            bool same = ref && got && size == e->usize && !memcmp(ref, got, size) &&
+                (u32)crc32(0, ref, size) == e->crc;
+            check(same, "%s: extracted file differs", dst);
+            checked++;
+            free(ref);
+            free(got);
+        }
+        printf("%s: %d files, %d MB checked\n", path, checked, (u32)(sel_bytes >> 20));
+    }
+
+    sd_cache_flush();
+    f_mount(NULL, "sd:", 1);
+    sd_mounted = false;
+    host_sd_close();
+    remove(image);
+    fclose(fp);
+    free(ents);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: test_inflate IMAGE [OmniNX-*.zip ...]\n");
+        return 2;
+    }
+
+    test_streams();
+    test_report("DEFLATE streams: ");
+
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++)
+            test_zip(argv[1], argv[i]);
+    } else {
+        char path[300];
+        snprintf(path, sizeof(path), "%s.zip", argv[1]);
+        check(make_zip(path), "%s: can't write the archive", path);
+        test_zip(argv[1], path);
+        remove(path);
+    }
+
+    return test_report("DEFLATE and ZIP: ");
+}
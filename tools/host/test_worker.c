@@ -0,0 +1,146 @@
+/*
+ * OmniNX Installer - Host test: A57 worker ring
+ *
+ * worker_ring.c, the BPMP side, against a second thread that does what the
+ * worker loop in source/worker_a57.S does: wait for head, read the job, store
+ * the result, move tail. The thread stalls at random, so the ring runs full
+ * and the submit side has to wait for free slots. The jobs work on buffers
+ * in the low 4GB, since the ring only has 32-bit addresses like the A57 ABI.
+ */
+
+#define _GNU_SOURCE
+
+#define TEST_SEED 0x9E3779B9
+
+#include "test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <worker.h>
+#include <worker_ring.h>
+
+#define ARENA_SIZE (8 * SZ_1M)
+#define TEST_JOBS  20000
+#define TEST_MS    2000
+
+static worker_ring_t ring __attribute__((aligned(64)));
+static worker_queue_t queue;
+static u8 *arena;
+
+/* The worker loop */
+
+static u32 a57_rnd_state = 0x7F4A7C15;
+
+static void a57_stall(void) {
+    a57_rnd_state ^= a57_rnd_state << 13;
+    a57_rnd_state ^= a57_rnd_state >> 17;
+    a57_rnd_state ^= a57_rnd_state << 5;
+
+    if (!(a57_rnd_state & 7))
+        for (u32 i = a57_rnd_state >> 24; i; i--)
+            sched_yield();
+}
+
+static void *a57_loop(void *arg) {
+    u32 done = 0;
+
+    while (true) {
+        while (ring.head == done)
+            sched_yield();
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); // DMB SY
+
+        a57_stall();
+        worker_job_t *job = &ring.jobs[done & (WORKER_RING_JOBS - 1)];
+        if (job->op == WORKER_OP_CRC32) {
+            job->result = crc32_calc(job->arg, (const u8 *)(uptr)job->src, job->size);
+        } else if (job->op == WORKER_OP_STOP) {
+            ring.tail = ++done;
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            return NULL;
+        }
+
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); // DMB SY
+        ring.tail = ++done;
+    }
+}
+
+/* Tests */
+
+typedef struct {
+    u32 seq;
+    u32 crc;
+} pending_t;
+
+// Bursts of up to 40 jobs, more than the ring holds. Only the last
+// WORKER_RING_JOBS of a burst still have their result in the ring.
+static void test_jobs(void) {
+    pending_t pend[40];
+    u32 jobs = 0;
+
+    while (jobs < TEST_JOBS) {
+        u32 burst = 1 + rnd() % 40;
+
+        for (u32 i = 0; i < burst; i++) {
+            u32 size = rnd() % 3 ? rnd() % 4096 : rnd() % SZ_256K;
+            u32 ofs = rnd() % (ARENA_SIZE - size);
+            u32 seed = rnd();
+
+            pend[i].crc = crc32_calc(seed, arena + ofs, size);
+            pend[i].seq = worker_queue_submit(&queue, WORKER_OP_CRC32, 0, (u32)(uptr)(arena + ofs), size, seed, TEST_MS);
+            check(pend[i].seq == queue.head && pend[i].seq, "submit (job %d)", pend[i].seq);
+            check(queue.head - ring.tail <= WORKER_RING_JOBS, "ring overrun (job %d)", pend[i].seq);
+        }
+
+        // In order or newest first, as worker_crc32_end() and a full ring do
+        bool reverse = rnd() & 1;
+        for (u32 n = 0; n < MIN(burst, WORKER_RING_JOBS); n++) {
+            u32 i = reverse ? burst - 1 - n : burst - MIN(burst, WORKER_RING_JOBS) + n;
+            u32 crc = 0;
+
+            bool ok = worker_queue_wait(&queue, pend[i].seq, &crc, TEST_MS);
+            check(ok, "wait timed out (job %d)", pend[i].seq);
+            check(crc == pend[i].crc, "wrong result (job %d)", pend[i].seq);
+        }
+        jobs += burst;
+    }
+}
+
+static void test_stop(void) {
+    u32 seq = worker_queue_submit(&queue, WORKER_OP_NOP, 0, 0, 0, 0, TEST_MS);
+    check(worker_queue_wait(&queue, seq, NULL, TEST_MS), "nop (job %d)", seq);
+
+    seq = worker_queue_submit(&queue, WORKER_OP_STOP, 0, 0, 0, 0, TEST_MS);
+    check(worker_queue_wait(&queue, seq, NULL, TEST_MS), "stop (job %d)", seq);
+
+    // Nobody answers any more: waits time out, and so does a full ring
+    seq = worker_queue_submit(&queue, WORKER_OP_NOP, 0, 0, 0, 0, TEST_MS);
+    check(!worker_queue_wait(&queue, seq, NULL, 50), "wait on a stopped worker (job %d)", seq);
+    for (u32 i = 1; i < WORKER_RING_JOBS; i++)
+        worker_queue_submit(&queue, WORKER_OP_NOP, 0, 0, 0, 0, 50);
+    check(!worker_queue_submit(&queue, WORKER_OP_NOP, 0, 0, 0, 0, 50), "submit to a full ring (job %d)", queue.head);
+}
+
+int main(int argc, char **argv) {
+    pthread_t a57;
+
+    arena = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (arena == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    for (u32 i = 0; i < ARENA_SIZE; i++)
+        arena[i] = (u8)rnd();
+
+    worker_queue_init(&queue, &ring);
+    pthread_create(&a57, NULL, a57_loop, NULL);
+
+    u32 start = get_tmr_ms();
+    test_jobs();
+    u32 ms = get_tmr_ms() - start;
+    test_stop();
+    pthread_join(a57, NULL);
+
+    return test_report("Worker ring: %d jobs in %d ms, ", queue.head, ms);
+}
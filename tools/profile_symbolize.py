@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#
+# OmniNX Installer - Profile symbolizer
+#
+# Maps the samples of a PROFILE=1 build (sd:/config/omninx/profile.bin) to the
+# functions of the engine, using the symbol table of the .elf it was built
+# from. The engine is position independent, bins are taken relative to its
+# __executable_start. Samples outside the engine (the stub in IRAM, the
+# bootrom) are listed by their run time address.
+#
+#   profile_symbolize.py profile.bin
+#   profile_symbolize.py --elf build/omninx-engine/omninx-engine.elf --lines 20 profile.bin
+#
+
+import argparse
+import bisect
+import collections
+import os
+import struct
+import subprocess
+import sys
+
+MAGIC = 0x464F5250
+VERSION = 1
+DEFAULT_ELF = 'build/omninx-engine/omninx-engine.elf'
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    hdr = struct.unpack_from('<8I', data)
+    if hdr[0] != MAGIC or hdr[1] != VERSION:
+        sys.exit('%s: not a version %d profile' % (path, VERSION))
+
+    period, base, nbins, samples, nraw, raw_total = hdr[2:]
+    bins = struct.unpack_from('<%dI' % nbins, data, 32)
+    raw = struct.unpack_from('<%dI' % nraw, data, 32 + nbins * 4)
+
+    return period, base, bins, samples, raw, raw_total
+
+
+def symbols(elf):
+    nm = 'arm-none-eabi-nm'
+    if os.environ.get('DEVKITARM'):
+        nm = os.path.join(os.environ['DEVKITARM'], 'bin', nm)
+
+    out = subprocess.run([nm, '-n', '--defined-only', elf], check=True,
+                         capture_output=True, text=True).stdout
+
+    addrs, names, start = [], [], 0
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[2] == '__executable_start':
+            start = int(parts[0], 16)
+        if len(parts) != 3 or parts[1] not in 'tTwW' or parts[2].startswith('$'):
+            continue
+        addrs.append(int(parts[0], 16) & ~1)
+        names.append(parts[2])
+
+    return addrs, names, start
+
+
+def main():
+    p = argparse.ArgumentParser(description='Symbolize an OmniNX BPMP profile')
+    p.add_argument('profile')
+    p.add_argument('--elf', default=DEFAULT_ELF)
+    p.add_argument('--lines', type=int, default=40, help='functions to list')
+    args = p.parse_args()
+
+    period, base, bins, samples, raw, raw_total = load(args.profile)
+    addrs, names, start = symbols(args.elf)
+
+    funcs = collections.Counter()
+    for i, n in enumerate(bins):
+        if not n:
+            continue
+        i_sym = bisect.bisect_right(addrs, start + i * 4) - 1
+        funcs[names[i_sym] if i_sym >= 0 else '?'] += n
+
+    if raw_total:
+        funcs['[outside engine]'] = raw_total
+
+    total = max(samples, 1)
+    print('%d samples every %d us (%.1f s)' % (samples, period, samples * period / 1e6))
+    print('engine code loaded at 0x%08X' % base)
+    print('%8s %6s  %s' % ('samples', '%', 'function'))
+    for name, n in funcs.most_common(args.lines):
+        print('%8d %5.1f%%  %s' % (n, n * 100.0 / total, name))
+
+    if raw:
+        print('\noutside the engine (%d of %d kept):' % (len(raw), raw_total))
+        for pc, n in collections.Counter(raw).most_common(10):
+            print('%8d  0x%08X' % (n, pc))
+
+
+if __name__ == '__main__':
+    main()
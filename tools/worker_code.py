@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+#
+# OmniNX Installer - A57 worker code check
+#
+# Assembles source/worker_a57.S (llvm-mc or an AArch64 binutils as) and
+# compares the result with the hand encoded worker_code[] in source/worker.c.
+# With --c it prints the array for worker.c instead, each word commented with
+# its offset and the line of the listing it comes from.
+#
+#   worker_code.py
+#   worker_code.py --c
+#
+
+import argparse
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+LISTING = 'source/worker_a57.S'
+SOURCE = 'source/worker.c'
+
+
+def assemble(path):
+    with tempfile.TemporaryDirectory() as tmp:
+        obj = os.path.join(tmp, 'worker.o')
+        if shutil.which('llvm-mc'):
+            cmd = ['llvm-mc', '-triple=aarch64', '-mattr=+crc', '-filetype=obj', path, '-o', obj]
+        elif shutil.which('aarch64-none-elf-as'):
+            cmd = ['aarch64-none-elf-as', '-march=armv8-a+crc', path, '-o', obj]
+        else:
+            sys.exit('worker_code.py: needs llvm-mc or aarch64-none-elf-as')
+        subprocess.run(cmd, check=True)
+        with open(obj, 'rb') as f:
+            elf = f.read()
+
+    # .text of a relocatable ELF64, nothing to link
+    shoff, = struct.unpack_from('<Q', elf, 0x28)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x3A)
+    sections = [struct.unpack_from('<IIQQQQ', elf, shoff + i * shentsize) for i in range(shnum)]
+    strtab = sections[shstrndx][4]
+    for name, _, _, _, offset, size in sections:
+        if elf[strtab + name:elf.index(b'\0', strtab + name)] == b'.text':
+            return elf[offset:offset + size]
+    sys.exit('worker_code.py: no .text in %s' % path)
+
+
+def listing_lines(path):
+    # One entry per 4 bytes: the labels in front of it and the source line
+    text = re.sub(r'/\*.*?\*/', '', open(path).read(), flags=re.S)
+    labels = []
+    out = []
+    for line in text.splitlines():
+        code, _, note = line.partition('//')
+        code = code.strip()
+        while re.match(r'^\w+:', code):
+            label, _, code = code.partition(':')
+            labels.append(label)
+            code = code.strip()
+        if not code or code.startswith('.text'):
+            continue
+        mnem, _, ops = code.partition(' ')
+        desc = '%-4s %s' % (mnem, ops.strip()) if ops else mnem
+        if labels:
+            desc = ': '.join(labels) + ': ' + desc
+        if note.strip():
+            desc += ' (%s)' % note.strip()
+        out.append(desc)
+        labels = []
+    return out
+
+
+def worker_c_bytes(path):
+    src = open(path).read()
+    body = src[src.index('worker_code[]'):]
+    body = body[body.index('{') + 1:body.index('};')]
+    words = ''.join(line.partition('//')[0] for line in body.splitlines())
+    return bytes(int(b, 16) for b in re.findall(r'0x([0-9A-Fa-f]{2})', words))
+
+
+def main():
+    p = argparse.ArgumentParser(description='Check the A57 worker code against its listing')
+    p.add_argument('--c', action='store_true', help='print worker_code[] for worker.c')
+    args = p.parse_args()
+
+    code = assemble(LISTING)
+    lines = listing_lines(LISTING)
+    if len(lines) * 4 != len(code):
+        sys.exit('worker_code.py: %d listing lines for %d bytes' % (len(lines), len(code)))
+
+    if args.c:
+        for i, desc in enumerate(lines):
+            word = ', '.join('0x%02X' % b for b in code[i * 4:i * 4 + 4])
+            print('\t%s, // 0x%03X: %s' % (word, i * 4, desc))
+        return 0
+
+    have = worker_c_bytes(SOURCE)
+    bad = 0
+    for i in range(0, max(len(code), len(have)), 4):
+        if code[i:i + 4] != have[i:i + 4]:
+            print('0x%03X: worker.c %s, listing %s (%s)' % (i, have[i:i + 4].hex() or '-', code[i:i + 4].hex() or '-',
+                                                          lines[i // 4] if i // 4 < len(lines) else ''))
+            bad += 1
+    if bad:
+        print('worker_code[] differs from %s in %d words, regenerate it with --c' % (LISTING, bad))
+        return 1
+
+    print('worker_code[]: %d bytes, matches %s' % (len(code), LISTING))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())